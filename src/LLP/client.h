@@ -71,7 +71,7 @@ namespace LLP
 			CLOSE         = 254
 		};
 		
-		inline Packet NewPacket() { return this->INCOMING; }
+		inline const Packet& NewPacket() { return this->INCOMING; }
 		
 		inline Packet GetPacket(unsigned char HEADER)
 		{
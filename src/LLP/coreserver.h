@@ -46,7 +46,7 @@ namespace LLP
 			{
 				if(fDDOS)
 				{
-					Packet PACKET   = this->INCOMING;
+					const Packet& PACKET = this->INCOMING;
 					
 					if(PACKET.HEADER == TIME_DATA)
 						DDOS->Ban();
@@ -90,7 +90,7 @@ namespace LLP
 			custom messaging system, and how to interpret it from raw packets. **/
 		bool ProcessPacket()
 		{
-			Packet PACKET   = this->INCOMING;
+			const Packet& PACKET = this->INCOMING;
 			
 			if(PACKET.HEADER == GET_OFFSET)
 			{
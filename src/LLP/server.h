@@ -13,9 +13,6 @@ namespace LLP
 		Not to be inherited, only for use by the LLP Server Base Class. **/
 	template <class ProtocolType> class DataThread
 	{
-		/** Data Thread. **/
-		Thread_t DATA_THREAD;
-		
 	public:
 	
 		/** Service that is used to handle Connections on this Thread. **/
@@ -24,6 +21,9 @@ namespace LLP
 		/** Variables to track Connection / Request Count. **/
 		bool fDDOS; unsigned int nConnections, ID, REQUESTS, TIMEOUT, DDOS_rSCORE, DDOS_cSCORE;
 		
+		/** Send Queue Depth across this Thread's Connections, total and largest single Connection, in Bytes. **/
+		unsigned int QUEUED, MAX_QUEUED;
+		
 		/** Vector to store Connections. **/
 		std::vector< ProtocolType* > CONNECTIONS;
 		
@@ -49,6 +49,7 @@ namespace LLP
 				DDOS -> cSCORE += 1;
 			
 			CONNECTIONS[nSlot] = new ProtocolType(SOCKET, DDOS, fDDOS);
+			CONNECTIONS[nSlot]->EnableSendQueue(SEND_QUEUE_HIGH_WATER);
 			
 			CONNECTIONS[nSlot]->Event(EVENT_CONNECT);
 			CONNECTIONS[nSlot]->CONNECTED = true;
@@ -78,7 +79,19 @@ namespace LLP
 				/** Keep data threads at 100 FPS Maximum. **/
 				Sleep(10);
 				
+				/** Run the Completion Handlers of any Asynchronous Writes that finished. **/
+				try
+				{
+					IO_SERVICE.reset();
+					IO_SERVICE.poll();
+				}
+				catch(std::exception& e)
+				{
+					printf("error: %s\n", e.what());
+				}
+				
 				/** Check all connections for data and packets. **/
+				unsigned int nQueued = 0, nMaxQueued = 0;
 				int nSize = CONNECTIONS.size();
 				for(int nIndex = 0; nIndex < nSize; nIndex++)
 				{
@@ -146,17 +159,30 @@ namespace LLP
 								CONNECTIONS[nIndex]->DDOS->rSCORE += 1;
 							
 						}
+						
+						/** Track the Send Queue Depth for the Meter. **/
+						unsigned int nDepth = CONNECTIONS[nIndex]->QueueDepth();
+						nQueued += nDepth;
+						nMaxQueued = std::max(nMaxQueued, nDepth);
 					}
 					catch(std::exception& e)
 					{
 						printf("error: %s\n", e.what());
 					}
 				}
+				
+				QUEUED     = nQueued;
+				MAX_QUEUED = nMaxQueued;
 			}
 		}
 		
 		DataThread<ProtocolType>(unsigned int id, bool isDDOS, unsigned int rScore, unsigned int cScore, unsigned int nTimeout) : 
-			ID(id), fDDOS(isDDOS), DDOS_rSCORE(rScore), DDOS_cSCORE(cScore), TIMEOUT(nTimeout), REQUESTS(0), CONNECTIONS(0), nConnections(0), DATA_THREAD(boost::bind(&DataThread::Thread, this)){ }
+			ID(id), fDDOS(isDDOS), DDOS_rSCORE(rScore), DDOS_cSCORE(cScore), TIMEOUT(nTimeout), REQUESTS(0), QUEUED(0), MAX_QUEUED(0), CONNECTIONS(0), nConnections(0), DATA_THREAD(boost::bind(&DataThread::Thread, this)){ }
+			
+	private:
+	
+		/** Data Thread. Declared last so it starts after the IO Service and Connections are constructed. **/
+		Thread_t DATA_THREAD;
 	};
 
 	
@@ -167,7 +193,7 @@ namespace LLP
 	{
 		/** The DDOS variables. Tracks the Requests and Connections per Second
 			from each connected address. **/
-		std::map<unsigned int,   DDOS_Filter*> DDOS_MAP;
+		DDOS_Table DDOS_TABLE;
 		bool fDDOS;
 		
 	public:
@@ -178,10 +204,13 @@ namespace LLP
 		
 		
 		Server<ProtocolType>(int nPort, int nMaxThreads, bool isDDOS, int cScore, int rScore, int nTimeout) : 
-			fDDOS(isDDOS), LISTENER(SERVICE), PORT(nPort), MAX_THREADS(nMaxThreads), LISTEN_THREAD(boost::bind(&Server::ListeningThread, this)) //,METER_THREAD(boost::bind(&Server::MeterThread, this)), 
+			DDOS_TABLE(30, nPort), fDDOS(isDDOS), LISTENER(SERVICE), PORT(nPort), MAX_THREADS(nMaxThreads), LISTEN_THREAD(boost::bind(&Server::ListeningThread, this)) //,METER_THREAD(boost::bind(&Server::MeterThread, this)), 
 		{
 			for(int index = 0; index < MAX_THREADS; index++)
 				DATA_THREADS.push_back(new DataThread<ProtocolType>(index, fDDOS, rScore, cScore, nTimeout));
+				
+			if(GetBoolArg("-llpmeter", false))
+				METER_THREAD = Thread_t(boost::bind(&Server::MeterThread, this));
 		}
 		
 	private:
@@ -211,7 +240,7 @@ namespace LLP
 			return nIndex;
 		}
 		
-		/** LLP Meter Thread. Tracks the Requests / Second. **/
+		/** LLP Meter Thread. Tracks the Requests / Second and Send Queue Depth. Enabled with -llpmeter. **/
 		void MeterThread()
 		{
 			Timer TIMER;
@@ -221,12 +250,16 @@ namespace LLP
 			{	
 				Sleep(10000);
 				
-				unsigned int nGlobalConnections = 0;
+				unsigned int nGlobalConnections = 0, nQueued = 0, nMaxQueued = 0;
 				for(int nIndex = 0; nIndex < MAX_THREADS; nIndex++)
+				{
 					nGlobalConnections += DATA_THREADS[nIndex]->nConnections;
+					nQueued            += DATA_THREADS[nIndex]->QUEUED;
+					nMaxQueued          = std::max(nMaxQueued, DATA_THREADS[nIndex]->MAX_QUEUED);
+				}
 					
 				double RPS = (double) TotalRequests() / TIMER.Elapsed();
-				printf("[METERS] LLP Running at %f Requests per Second with %u Connections.\n", RPS, nGlobalConnections);
+				printf("[METERS] LLP Running at %f Requests per Second with %u Connections. %u Bytes Queued, Largest Queue %u Bytes.\n", RPS, nGlobalConnections, nQueued, nMaxQueued);
 				
 				TIMER.Reset();
 				ClearRequests();
@@ -268,29 +301,23 @@ namespace LLP
 					LISTENER.accept(*SOCKET);
 					
 					/** Initialize DDOS Protection for Incoming IP Address. **/
-					std::vector<unsigned char> BYTES(4, 0);
-					sscanf(SOCKET->remote_endpoint().address().to_string().c_str(), "%u.%u.%u.%u", &BYTES[0], &BYTES[1], &BYTES[2], &BYTES[3]);
-					unsigned int ADDRESS = (BYTES[0] << 24) + (BYTES[1] << 16) + (BYTES[2] << 8) + BYTES[3];
+					boost::asio::ip::address ADDRESS = SOCKET->remote_endpoint().address();
+					DDOS_Filter* DDOS = DDOS_TABLE.Find(ADDRESS);
 					
-					{ //LOCK(DDOS_MUTEX);
-						if(!DDOS_MAP.count(ADDRESS))
-							DDOS_MAP[ADDRESS] = new DDOS_Filter(30);
-							
-						/** DDOS Operations: Only executed when DDOS is enabled. **/
-						if((fDDOS && DDOS_MAP[ADDRESS]->Banned()) || !CheckPermissions(strprintf("%u.%u.%u.%u:%u",BYTES[0], BYTES[1], BYTES[2], BYTES[3], PORT)))
-						{
-							SOCKET -> shutdown(boost::asio::ip::tcp::socket::shutdown_both, ERROR_HANDLE);
-							SOCKET -> close();
+					/** DDOS Operations: Only executed when DDOS is enabled. **/
+					if((fDDOS && DDOS->Banned()) || !DDOS->fAllowed)
+					{
+						SOCKET -> shutdown(boost::asio::ip::tcp::socket::shutdown_both, ERROR_HANDLE);
+						SOCKET -> close();
+						
+						printf("##### BLOCKED: LLP Connection Request from %s to Port %u\n", ADDRESS.to_string().c_str(), PORT);
 							
-							printf("##### BLOCKED: LLP Connection Request from %u.%u.%u.%u to Port %u\n", BYTES[0], BYTES[1], BYTES[2], BYTES[3], PORT);
-								
-							continue;
-						}
-					
-					
-						/** Add new connection if passed all DDOS checks. **/
-						DATA_THREADS[nThread]->AddConnection(SOCKET, DDOS_MAP[ADDRESS]);
+						continue;
 					}
+				
+				
+					/** Add new connection if passed all DDOS checks. **/
+					DATA_THREADS[nThread]->AddConnection(SOCKET, DDOS);
 				}
 				catch(std::exception& e)
 				{
@@ -3,12 +3,16 @@
 
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include <deque>
 #include <string>
 #include <vector>
 #include <stdio.h>
 #include <boost/bind.hpp>
 #include <boost/smart_ptr.hpp>
 #include <boost/asio.hpp>
+#include <boost/array.hpp>
+#include <boost/atomic.hpp>
+#include <boost/scoped_array.hpp>
 #include <boost/thread/thread.hpp>         
 
 #define LOCK_GUARD(a) boost::lock_guard<boost::mutex> lock(a)
@@ -38,6 +42,10 @@ namespace LLP
 	typedef boost::mutex                                         Mutex_t;
 	
 	
+	/** Bytes a Server Connection may have waiting to be Written before it is Disconnected. **/
+	static const unsigned int SEND_QUEUE_HIGH_WATER = 4 * 1024 * 1024;
+	
+	
 	/** Sleep for a duration in Milliseconds. **/
 	inline void Sleep(unsigned int nTime){ boost::this_thread::sleep(boost::posix_time::milliseconds(nTime)); }
 	
@@ -76,113 +84,101 @@ namespace LLP
 	};
 	
 	
+	/** Current Time in whole Seconds. Clock used by the DDOS Scores and Filters. **/
+	inline unsigned int Seconds(){ return (unsigned int) time(NULL); }
+	
+	
 	/** Class that tracks DDOS attempts on LLP Servers. 
-		Uses a Timer to calculate Request Score [rScore] and Connection Score [cScore] as a unit of Score / Second. 
-		Pointer stored by Connection class and Server Listener DDOS_MAP. **/
+		Calculates Request Score [rScore] and Connection Score [cScore] as a unit of Score / Second. 
+		Ring Buffer of one Slot per Second with a running Total, so Scoring and reading the Score are O(1).
+		Lock Free: a Score added while its Slot is being recycled for a new Second may be dropped. **/
 	class DDOS_Score
 	{
-		std::vector< std::pair<bool, int> > SCORE;
-		Timer TIMER;
-		int nIterator;
-		Mutex_t MUTEX;
+		boost::scoped_array< boost::atomic<int> > SCORE;
+		unsigned int nTimespan;
+		
+		boost::atomic<int> nTotal;
+		boost::atomic<unsigned int> nLast;
 		
 		
-		/** Reset the Timer and the Score Flags to be Overwritten. **/
-		void Reset()
+		/** Move the Window up to the current Second, clearing the Slots of each Second that passed since the last Score.
+			Clears at most nTimespan Slots, once per Second. **/
+		unsigned int Advance()
 		{
-			for(int i = 0; i < SCORE.size(); i++)
-				SCORE[i].first = false;
-				
-			TIMER.Reset();
-			nIterator = 0;
+			unsigned int nNow  = Seconds();
+			unsigned int nPrev = nLast.load();
+			
+			while(nNow > nPrev)
+			{
+				if(!nLast.compare_exchange_weak(nPrev, nNow))
+					continue;
+					
+				unsigned int nClear = std::min(nNow - nPrev, nTimespan);
+				for(unsigned int i = 1; i <= nClear; i++)
+					nTotal -= SCORE[(nPrev + i) % nTimespan].exchange(0);
+					
+				break;
+			}
+			
+			return nNow;
 		}
 		
 	public:
 	
 		/** Construct a DDOS Score of Moving Average Timespan. **/
-		DDOS_Score(int nTimespan)
+		DDOS_Score(int nTimespanIn) : SCORE(new boost::atomic<int>[std::max(nTimespanIn, 1)]), nTimespan(std::max(nTimespanIn, 1)), nTotal(0), nLast(Seconds())
 		{
-			LOCK_GUARD(MUTEX);
-			
-			for(int i = 0; i < nTimespan; i++)
-				SCORE.push_back(std::make_pair(true, 0));
-				
-			TIMER.Start();
-			nIterator = 0;
+			for(unsigned int i = 0; i < nTimespan; i++)
+				SCORE[i] = 0;
 		}
 		
 		
 		/** Flush the DDOS Score to 0. **/
 		void Flush()
 		{
-			LOCK_GUARD(MUTEX);
-			
-			Reset();
-			for(int i = 0; i < SCORE.size(); i++)
-				SCORE[i].second = 0;
+			for(unsigned int i = 0; i < nTimespan; i++)
+				nTotal -= SCORE[i].exchange(0);
 		}
 		
 		
 		/** Access the DDOS Score from the Moving Average. **/
 		int Score()
 		{
-			LOCK_GUARD(MUTEX);
+			Advance();
 			
-			int nMovingAverage = 0;
-			for(int i = 0; i < SCORE.size(); i++)
-				nMovingAverage += SCORE[i].second;
-			
-			return nMovingAverage / SCORE.size();
+			return std::max(nTotal.load(), 0) / (int) nTimespan;
 		}
 		
 		
 		/** Increase the Score by nScore. Operates on the Moving Average to Increment Score per Second. **/
 		DDOS_Score & operator+=(const int& nScore)
 		{
-			LOCK_GUARD(MUTEX);
-			
-			int nTime = TIMER.Elapsed();
-			
-			
-			/** If the Time has been greater than Moving Average Timespan, Set to Add Score on Time Overlap. **/
-			if(nTime >= SCORE.size())
-			{
-				Reset();
-				nTime = nTime % SCORE.size();
-			}
-				
-				
-			/** Iterate as many seconds as needed, flagging that each has been iterated. **/
-			for(int i = nIterator; i <= nTime; i++)
-			{
-				if(!SCORE[i].first)
-				{
-					SCORE[i].first  = true;
-					SCORE[i].second = 0;
-				}
-			}
-			
-			
-			/** Update the Moving Average Iterator and Score for that Second Instance. **/
-			SCORE[nTime].second += nScore;
-			nIterator = nTime;
+			unsigned int nNow = Advance();
 			
+			SCORE[nNow % nTimespan] += nScore;
+			nTotal += nScore;
 			
 			return *this;
 		}
 	};
 	
 	
-	/** Filter to Contain DDOS Scores and Handle DDOS Bans. **/
+	/** Filter to Contain DDOS Scores and Handle DDOS Bans. One per Address, shared by all its Connections. **/
 	class DDOS_Filter
 	{
-		Timer TIMER;
-		unsigned int BANTIME, TOTALBANS;
+		boost::atomic<unsigned int> BANSTART, BANTIME, TOTALBANS;
+		Mutex_t MUTEX;
 		
 	public:
 		DDOS_Score rSCORE, cSCORE;
-		DDOS_Filter(unsigned int nTimespan) : rSCORE(nTimespan), cSCORE(nTimespan), BANTIME(0), TOTALBANS(0) { }
-		Mutex_t MUTEX;
+		
+		/** Connections currently holding this Filter, and the last Second one was opened or closed. **/
+		boost::atomic<unsigned int> nReferences, nLastSeen;
+		
+		/** Result of the -llpallowip check for this Address, cached when the Filter is created. **/
+		bool fAllowed;
+		
+		DDOS_Filter(unsigned int nTimespan) : BANSTART(0), BANTIME(0), TOTALBANS(0), rSCORE(nTimespan), cSCORE(nTimespan), nReferences(0), nLastSeen(Seconds()), fAllowed(false) { }
 		
 		/** Ban a Connection, and Flush its Scores. **/
 		void Ban()
@@ -192,23 +188,241 @@ namespace LLP
 			if(Banned())
 				return;
 			
-			TIMER.Start();
+			int rScore = rSCORE.Score(), cScore = cSCORE.Score();
 			TOTALBANS++;
 			
-			BANTIME = std::max(TOTALBANS * (rSCORE.Score() + 1) * (cSCORE.Score() + 1), TOTALBANS * 1200u);
+			BANTIME  = std::max(TOTALBANS * (rScore + 1) * (cScore + 1), TOTALBANS * 1200u);
+			BANSTART = Seconds();
 			
-			printf("XXXXX DDOS Filter cScore = %i rScore = %i Banned for %u Seconds.\n", cSCORE.Score(), rSCORE.Score(), BANTIME);
+			printf("XXXXX DDOS Filter cScore = %i rScore = %i Banned for %u Seconds.\n", cScore, rScore, BANTIME.load());
 			
 			cSCORE.Flush();
 			rSCORE.Flush();
 		}
 		
 		/** Check if Connection is Still Banned. **/
-		bool Banned() { return (TIMER.Elapsed() < BANTIME); }
+		bool Banned() { unsigned int nTime = BANTIME; return (nTime > 0 && Seconds() - BANSTART < nTime); }
+		
+		/** Number of times this Address was Banned. **/
+		unsigned int TotalBans() { return TOTALBANS; }
+	};
+	
+	
+	/** Filters are Evicted once Idle this many Seconds, or this many if the Address was ever Banned. **/
+	static const unsigned int DDOS_FILTER_EXPIRE        = 600;
+	static const unsigned int DDOS_FILTER_EXPIRE_BANNED = 24 * 60 * 60;
+	
+	
+	/** Open Addressing Table of DDOS Filters keyed by IPv4 or IPv6 Address, with Linear Probing.
+		Only used by the Listening Thread: Connections keep a direct pointer to their Filter,
+		so per Packet checks never touch the Table. Idle Filters are Evicted once a Minute. **/
+	class DDOS_Table
+	{
+		typedef boost::array<unsigned char, 16> Address_t;
+		
+		struct Entry
+		{
+			Address_t    ADDRESS;
+			DDOS_Filter* FILTER;
+		};
+		
+		std::vector<Entry> TABLE;
+		unsigned int nSize, nTimespan, nPort, nLastEvict;
+		uint64 nSalt;
+		
+		
+		/** IPv4 Addresses are stored as IPv4 Mapped IPv6 Addresses. **/
+		static Address_t Key(const boost::asio::ip::address& ADDRESS)
+		{
+			Address_t KEY;
+			if(ADDRESS.is_v6())
+			{
+				boost::asio::ip::address_v6::bytes_type BYTES = ADDRESS.to_v6().to_bytes();
+				std::copy(BYTES.begin(), BYTES.end(), KEY.begin());
+				
+				return KEY;
+			}
+				
+			KEY.assign(0);
+			KEY[10] = KEY[11] = 0xff;
+			
+			boost::asio::ip::address_v4::bytes_type BYTES = ADDRESS.to_v4().to_bytes();
+			std::copy(BYTES.begin(), BYTES.end(), KEY.begin() + 12);
+			
+			return KEY;
+		}
+		
+		
+		/** Salted so the Probe Sequence can't be predicted from the Address. **/
+		size_t Hash(const Address_t& KEY) const
+		{
+			uint64 a, b;
+			memcpy(&a, &KEY[0], 8);
+			memcpy(&b, &KEY[8], 8);
+			
+			uint64 h = (a ^ nSalt) * 0x9E3779B97F4A7C15ULL;
+			h = (h ^ (h >> 29) ^ b) * 0xBF58476D1CE4E5B9ULL;
+			
+			return (size_t)(h ^ (h >> 32));
+		}
+		
+		
+		/** Slot holding KEY, or the empty Slot where it would be Inserted. **/
+		size_t Probe(const Address_t& KEY) const
+		{
+			size_t nMask = TABLE.size() - 1, nIndex = Hash(KEY) & nMask;
+			while(TABLE[nIndex].FILTER && TABLE[nIndex].ADDRESS != KEY)
+				nIndex = (nIndex + 1) & nMask;
+				
+			return nIndex;
+		}
+		
+		
+		/** Double the Table and re-Insert every Entry. **/
+		void Grow()
+		{
+			std::vector<Entry> OLD(TABLE.size() * 2);
+			OLD.swap(TABLE);
+			
+			for(size_t i = 0; i < TABLE.size(); i++)
+				TABLE[i].FILTER = NULL;
+			
+			for(size_t i = 0; i < OLD.size(); i++)
+				if(OLD[i].FILTER)
+					TABLE[Probe(OLD[i].ADDRESS)] = OLD[i];
+		}
+		
+		
+		/** Remove the Entry at nIndex, shifting back Entries of its Probe Chain so no Tombstones are needed. **/
+		void Erase(size_t nIndex)
+		{
+			size_t nMask = TABLE.size() - 1;
+			
+			delete TABLE[nIndex].FILTER;
+			TABLE[nIndex].FILTER = NULL;
+			nSize--;
+			
+			for(size_t j = (nIndex + 1) & nMask; TABLE[j].FILTER; j = (j + 1) & nMask)
+			{
+				size_t nHome = Hash(TABLE[j].ADDRESS) & nMask;
+				if(((j - nHome) & nMask) < ((j - nIndex) & nMask))
+					continue;
+					
+				TABLE[nIndex] = TABLE[j];
+				TABLE[j].FILTER = NULL;
+				nIndex = j;
+			}
+		}
+		
+		
+		/** Remove Filters with no Connections that are not Banned and have been Idle past their Expiration. **/
+		void Evict(unsigned int nNow)
+		{
+			size_t nIndex = 0;
+			while(nIndex < TABLE.size())
+			{
+				DDOS_Filter* FILTER = TABLE[nIndex].FILTER;
+				if(FILTER && FILTER->nReferences == 0 && !FILTER->Banned() &&
+					nNow - FILTER->nLastSeen > (FILTER->TotalBans() ? DDOS_FILTER_EXPIRE_BANNED : DDOS_FILTER_EXPIRE))
+				{
+					/** Erase may shift another Entry into this Slot, so check it again. **/
+					Erase(nIndex);
+					
+					continue;
+				}
+				
+				nIndex++;
+			}
+			
+			nLastEvict = nNow;
+		}
+		
+	public:
+	
+		DDOS_Table(unsigned int nTimespanIn, unsigned int nPortIn) : TABLE(1024), nSize(0), nTimespan(nTimespanIn), nPort(nPortIn), nLastEvict(Seconds()), nSalt(GetRand(std::numeric_limits<uint64>::max()))
+		{
+			for(size_t i = 0; i < TABLE.size(); i++)
+				TABLE[i].FILTER = NULL;
+		}
+		
+		~DDOS_Table()
+		{
+			for(size_t i = 0; i < TABLE.size(); i++)
+				delete TABLE[i].FILTER;
+		}
+		
+		
+		/** Number of Addresses being Tracked. **/
+		unsigned int Size() const { return nSize; }
+		
+		
+		/** Get the Filter for an Address, creating it if this Address has not been seen or was Evicted. **/
+		DDOS_Filter* Find(const boost::asio::ip::address& ADDRESS)
+		{
+			unsigned int nNow = Seconds();
+			if(nNow - nLastEvict >= 60)
+				Evict(nNow);
+				
+			Address_t KEY = Key(ADDRESS);
+			size_t nIndex = Probe(KEY);
+			if(TABLE[nIndex].FILTER)
+				return TABLE[nIndex].FILTER;
+				
+			/** Keep the Load Factor at or below one half. **/
+			if((nSize + 1) * 2 > TABLE.size())
+			{
+				Grow();
+				nIndex = Probe(KEY);
+			}
+			
+			DDOS_Filter* FILTER = new DDOS_Filter(nTimespan);
+			FILTER->fAllowed = CheckPermissions(strprintf("%s:%u", ADDRESS.to_string().c_str(), nPort));
+			
+			TABLE[nIndex].ADDRESS = KEY;
+			TABLE[nIndex].FILTER  = FILTER;
+			nSize++;
+			
+			return FILTER;
+		}
+		
+		
+		/** Self-check: Growing keeps every Entry, and Evicting every other Entry leaves the rest reachable through the shifted Probe Chains. **/
+		static bool SelfTest()
+		{
+			DDOS_Table cTable(10, 0);
+			
+			std::vector<DDOS_Filter*> vFilters;
+			for(unsigned int i = 0; i < 2000; i++)
+				vFilters.push_back(cTable.Find(boost::asio::ip::address(boost::asio::ip::address_v4(i + 1))));
+				
+			if(cTable.Size() != 2000)
+				return false;
+				
+			/** Odd Entries are seen in the future of the Eviction Time so only Even Entries Expire. **/
+			unsigned int nNow = Seconds() + DDOS_FILTER_EXPIRE + 1;
+			for(unsigned int i = 1; i < 2000; i += 2)
+				vFilters[i]->nLastSeen = nNow;
+				
+			cTable.Evict(nNow);
+			if(cTable.Size() != 1000)
+				return false;
+				
+			for(unsigned int i = 1; i < 2000; i += 2)
+			{
+				size_t nIndex = cTable.Probe(Key(boost::asio::ip::address(boost::asio::ip::address_v4(i + 1))));
+				if(cTable.TABLE[nIndex].FILTER != vFilters[i])
+					return false;
+			}
+			
+			for(unsigned int i = 0; i < 2000; i += 2)
+				if(cTable.TABLE[cTable.Probe(Key(boost::asio::ip::address(boost::asio::ip::address_v4(i + 1))))].FILTER)
+					return false;
+					
+			return true;
+		}
 	};
 	
 	
-
 	/** Class to handle sending and receiving of LLP Packets. **/
 	class Packet
 	{
@@ -235,36 +449,158 @@ namespace LLP
 		
 		
 		/** Packet Null Flag. Header = 255. **/
-		bool IsNull() { return (HEADER == 255); }
+		bool IsNull() const { return (HEADER == 255); }
 		
 		
 		/** Determine if a packet is fully read. **/
-		bool Complete() { return (Header() && DATA.size() == LENGTH); }
+		bool Complete() const { return (Header() && DATA.size() == LENGTH); }
 		
 		
 		/** Determine if header is fully read **/
-		bool Header() { return IsNull() ? false : (HEADER < 128 && LENGTH > 0) || (HEADER >= 128 && HEADER < 255 && LENGTH == 0); }
+		bool Header() const { return IsNull() ? false : (HEADER < 128 && LENGTH > 0) || (HEADER >= 128 && HEADER < 255 && LENGTH == 0); }
+		
+		
+		/** Sets the size of the packet from the 4 Length Bytes. **/
+		void SetLength(const unsigned char* BYTES) { LENGTH = (BYTES[0] << 24) + (BYTES[1] << 16) + (BYTES[2] << 8) + (BYTES[3] ); }
+		void SetLength(const std::vector<unsigned char>& BYTES) { SetLength(&BYTES[0]); }
 		
 		
-		/** Sets the size of the packet from Byte Vector. **/
-		void SetLength(std::vector<unsigned char> BYTES) { LENGTH = (BYTES[0] << 24) + (BYTES[1] << 16) + (BYTES[2] << 8) + (BYTES[3] ); }
+		/** Encode the Header and Length in place. Returns the number of Bytes used [1 for Requests, 5 for Data Packets]. **/
+		unsigned int EncodeHeader(unsigned char* BYTES) const
+		{
+			BYTES[0] = HEADER;
+			if(HEADER >= 128)
+				return 1;
+				
+			BYTES[1] = (LENGTH >> 24); BYTES[2] = (LENGTH >> 16);
+			BYTES[3] = (LENGTH >> 8);  BYTES[4] = LENGTH;
+			
+			return 5;
+		}
 		
 		
-		/** Serializes class into a Byte Vector. Used to write Packet to Sockets. **/
-		std::vector<unsigned char> GetBytes()
+		/** Serializes class into a Byte Vector. Socket writes use EncodeHeader and the Data directly instead. **/
+		std::vector<unsigned char> GetBytes() const
 		{
-			std::vector<unsigned char> BYTES(1, HEADER);
+			unsigned char BYTES[5];
+			unsigned int nSize = EncodeHeader(BYTES);
 			
-			/** Handle for Data Packets. **/
+			std::vector<unsigned char> DATA_BYTES(BYTES, BYTES + nSize);
 			if(HEADER < 128)
+				DATA_BYTES.insert(DATA_BYTES.end(),  DATA.begin(), DATA.end());
+			
+			return DATA_BYTES;
+		}
+	};
+	
+	
+	
+	/** Outbound Data of a Server Connection, drained by Asynchronous Writes on the Data Thread's IO Service.
+		Queued Packets keep their Data in a Reference Counted Buffer, and Packets Queued while a Write is in flight
+		go out together in the next Write as one Buffer Sequence, so no Payload is copied on the way to the Socket.
+		The Write Handler holds its own reference so an in-flight Write can outlive the Connection. **/
+	class SendQueue : public boost::enable_shared_from_this<SendQueue>
+	{
+		/** Encoded Header of a Queued Packet and its shared Data. **/
+		struct Entry
+		{
+			unsigned char HEADER[5];
+			unsigned int nHeader;
+			
+			boost::shared_ptr<const std::vector<unsigned char> > DATA;
+		};
+		
+		Socket_t SOCKET;
+		
+		/** PENDING collects new Packets, SENDING and its Buffers are owned by the Write in flight. **/
+		std::deque<Entry> PENDING, SENDING;
+		std::vector<boost::asio::const_buffer> BUFFERS;
+		unsigned int nPendingBytes, nSendingBytes;
+		
+		unsigned int nHighWater;
+		bool fWriting;
+		
+		
+		/** Write Completion Handler. Starts the next Write if more data was Queued in the meantime. **/
+		void Complete(const Error_t& ERROR_CODE, size_t nBytes)
+		{
+			fWriting = false;
+			SENDING.clear();
+			BUFFERS.clear();
+			nSendingBytes = 0;
+			
+			if(ERROR_CODE)
 			{
-				BYTES.push_back((LENGTH >> 24)); BYTES.push_back((LENGTH >> 16));
-				BYTES.push_back((LENGTH >> 8));  BYTES.push_back(LENGTH);
+				ERROR_HANDLE = ERROR_CODE;
+				return;
+			}
+			
+			Flush();
+		}
+		
+	public:
+	
+		/** Error from the last Asynchronous Write. **/
+		Error_t ERROR_HANDLE;
+		
+		
+		/** Set once the Queue grew past its High Water Mark. **/
+		bool fOverflow;
+		
+		
+		SendQueue(Socket_t SOCKET_IN, unsigned int nHighWaterIn) : SOCKET(SOCKET_IN), nPendingBytes(0), nSendingBytes(0), nHighWater(nHighWaterIn), fWriting(false), fOverflow(false) { }
+		
+		
+		/** Number of Bytes waiting to be Written, including the Write in flight. **/
+		unsigned int Depth() const { return nPendingBytes + nSendingBytes; }
+		
+		
+		/** Append a Packet to the Queue. The Queue takes over the Data of the Packet instead of copying it. **/
+		void Push(Packet& PACKET)
+		{
+			Entry ENTRY;
+			ENTRY.nHeader = PACKET.EncodeHeader(ENTRY.HEADER);
+			nPendingBytes += ENTRY.nHeader;
+			
+			if(PACKET.HEADER < 128 && !PACKET.DATA.empty())
+			{
+				boost::shared_ptr<std::vector<unsigned char> > DATA(new std::vector<unsigned char>());
+				DATA->swap(PACKET.DATA);
+				
+				nPendingBytes += DATA->size();
+				ENTRY.DATA = DATA;
+			}
+			
+			PENDING.push_back(ENTRY);
+			if(!fOverflow && Depth() > nHighWater)
+			{
+				fOverflow = true;
+				printf("***** LLP Send Queue Over High Water Mark (%u Bytes)\n", Depth());
+			}
+		}
+		
+		
+		/** Start a Write of everything Queued unless one is already in flight. **/
+		void Flush()
+		{
+			if(fWriting || PENDING.empty() || ERROR_HANDLE)
+				return;
 				
-				BYTES.insert(BYTES.end(),  DATA.begin(), DATA.end());
+			SENDING.swap(PENDING);
+			nSendingBytes = nPendingBytes;
+			nPendingBytes = 0;
+			
+			/** The Entries stay put in SENDING until the Write Completes, so the Buffers can point into them. **/
+			for(std::deque<Entry>::const_iterator ENTRY = SENDING.begin(); ENTRY != SENDING.end(); ++ENTRY)
+			{
+				BUFFERS.push_back(boost::asio::buffer(ENTRY->HEADER, ENTRY->nHeader));
+				if(ENTRY->DATA)
+					BUFFERS.push_back(boost::asio::buffer(*ENTRY->DATA));
 			}
 			
-			return BYTES;
+			fWriting = true;
+			boost::asio::async_write(*SOCKET, BUFFERS,
+				boost::bind(&SendQueue::Complete, shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
 		}
 	};
 	
@@ -281,6 +617,10 @@ namespace LLP
 		Socket_t      SOCKET;
 		
 		
+		/** Asynchronous Outbound Queue. Writes are Blocking while it is not Enabled. **/
+		boost::shared_ptr<SendQueue> SEND_QUEUE;
+		
+		
 		/** 
 			Virtual Event Function to be Overridden allowing Custom Read Events. 
 			Each event fired on Header Complete, and each time data is read to fill packet.
@@ -315,11 +655,39 @@ namespace LLP
 		
 		/** Connection Constructors **/
 		Connection() : SOCKET(), DDOS(NULL), INCOMING(), CONNECTED(false), fDDOS(false) { INCOMING.SetNull(); }
-		Connection( Socket_t SOCKET_IN, DDOS_Filter* DDOS_IN, bool isDDOS = false) : SOCKET(SOCKET_IN), fDDOS(isDDOS), DDOS(DDOS_IN), INCOMING(), CONNECTED(false) { TIMER.Start(); }
+		Connection( Socket_t SOCKET_IN, DDOS_Filter* DDOS_IN, bool isDDOS = false) : SOCKET(SOCKET_IN), fDDOS(isDDOS), DDOS(DDOS_IN), INCOMING(), CONNECTED(false)
+		{
+			TIMER.Start();
+			
+			if(DDOS)
+			{
+				DDOS->nLastSeen = Seconds();
+				DDOS->nReferences++;
+			}
+		}
 		
 		
-		/** Checks for any flags in the Error Handle. **/
-		bool Errors(){ return (ERROR_HANDLE == boost::asio::error::eof || ERROR_HANDLE); }
+		/** Release the DDOS Filter so the Listener may Evict it once Idle. **/
+		~Connection()
+		{
+			if(DDOS)
+			{
+				DDOS->nLastSeen = Seconds();
+				DDOS->nReferences--;
+			}
+		}
+		
+		
+		/** Checks for any flags in the Error Handle, or a Send Queue that failed or overflowed. **/
+		bool Errors(){ return (ERROR_HANDLE == boost::asio::error::eof || ERROR_HANDLE || (SEND_QUEUE && (SEND_QUEUE->ERROR_HANDLE || SEND_QUEUE->fOverflow))); }
+		
+		
+		/** Switch this Connection to Asynchronous Writes. Disconnects once more than nHighWater Bytes are waiting. **/
+		void EnableSendQueue(unsigned int nHighWater){ SEND_QUEUE.reset(new SendQueue(SOCKET, nHighWater)); }
+		
+		
+		/** Bytes waiting in the Send Queue. **/
+		unsigned int QueueDepth(){ return SEND_QUEUE ? SEND_QUEUE->Depth() : 0; }
 				
 				
 		/** Determines if nTime seconds have elapsed since last Read / Write. **/
@@ -338,8 +706,32 @@ namespace LLP
 		void ResetPacket(){ INCOMING.SetNull(); }
 		
 		
-		/** Write a single packet to the TCP stream. **/
-		void WritePacket(Packet PACKET) { Write(PACKET.GetBytes()); }
+		/** Write a single packet to the TCP stream. Queued if the Send Queue is Enabled, which takes the Data out of the Packet,
+			otherwise Header and Data go out as one gathered write without being copied together. **/
+		void WritePacket(Packet& PACKET)
+		{
+			if(Errors())
+				return;
+				
+			if(SEND_QUEUE)
+			{
+				TIMER.Reset();
+				SEND_QUEUE->Push(PACKET);
+				SEND_QUEUE->Flush();
+				
+				return;
+			}
+			
+			unsigned char HEADER[5];
+			unsigned int nSize = PACKET.EncodeHeader(HEADER);
+			
+			boost::array<boost::asio::const_buffer, 2> BUFFERS = {{
+				boost::asio::buffer(HEADER, nSize),
+				boost::asio::buffer(PACKET.DATA, (PACKET.HEADER < 128) ? PACKET.DATA.size() : 0) }};
+			
+			TIMER.Reset();
+			boost::asio::write(*SOCKET, BUFFERS, ERROR_HANDLE);
+		}
 		
 		
 		/** Non-Blocking Packet reader to build a packet from TCP Connection.
@@ -350,9 +742,9 @@ namespace LLP
 			/** Handle Reading Packet Type Header. **/
 			if(SOCKET->available() > 0 && INCOMING.IsNull())
 			{
-				std::vector<unsigned char> HEADER(1, 255);
-				if(Read(HEADER, 1) == 1)
-					INCOMING.HEADER = HEADER[0];
+				unsigned char HEADER = 255;
+				if(Read(&HEADER, 1) == 1)
+					INCOMING.HEADER = HEADER;
 					
 			}
 				
@@ -361,7 +753,7 @@ namespace LLP
 				/** Handle Reading Packet Length Header. **/
 				if(SOCKET->available() >= 4 && INCOMING.LENGTH == 0)
 				{
-					std::vector<unsigned char> BYTES(4, 0);
+					unsigned char BYTES[4];
 					if(Read(BYTES, 4) == 4)
 					{
 						INCOMING.SetLength(BYTES);
@@ -369,18 +761,19 @@ namespace LLP
 					}
 				}
 					
-				/** Handle Reading Packet Data. **/
+				/** Handle Reading Packet Data. Read straight into the Packet's Data. **/
 				unsigned int nAvailable = SOCKET->available();
 				if(nAvailable > 0 && INCOMING.LENGTH > 0 && INCOMING.DATA.size() < INCOMING.LENGTH)
 				{
-					std::vector<unsigned char> DATA( std::min(nAvailable, (unsigned int)(INCOMING.LENGTH - INCOMING.DATA.size())), 0);
-					unsigned int nRead = Read(DATA, DATA.size());
+					unsigned int nOffset = INCOMING.DATA.size();
+					unsigned int nSize   = std::min(nAvailable, (unsigned int)(INCOMING.LENGTH - nOffset));
 					
-					if(nRead == DATA.size())
-					{
-						INCOMING.DATA.insert(INCOMING.DATA.end(), DATA.begin(), DATA.end());
+					INCOMING.DATA.resize(nOffset + nSize);
+					unsigned int nRead = Read(&INCOMING.DATA[nOffset], nSize);
+					
+					INCOMING.DATA.resize(nOffset + nRead);
+					if(nRead > 0)
 						Event(EVENT_PACKET, nRead);
-					}
 				}
 			}
 		}
@@ -406,16 +799,18 @@ namespace LLP
 	private:
 		
 		/** Lower level network communications: Read. Interacts with OS sockets. **/
-		size_t Read(std::vector<unsigned char> &DATA, size_t nBytes) { if(Errors()) return 0; TIMER.Reset(); return  boost::asio::read(*SOCKET, boost::asio::buffer(DATA, nBytes), ERROR_HANDLE); }
+		size_t Read(unsigned char* DATA, size_t nBytes) { if(Errors()) return 0; TIMER.Reset(); return  boost::asio::read(*SOCKET, boost::asio::buffer(DATA, nBytes), ERROR_HANDLE); }
 							
 				
 				
 		/** Lower level network communications: Write. Interacts with OS sockets. **/
-		void Write(std::vector<unsigned char> DATA) { if(Errors()) return; TIMER.Reset(); boost::asio::write(*SOCKET, boost::asio::buffer(DATA, DATA.size()), ERROR_HANDLE); }
+		void Write(const std::vector<unsigned char>& DATA) { if(Errors()) return; TIMER.Reset(); boost::asio::write(*SOCKET, boost::asio::buffer(DATA, DATA.size()), ERROR_HANDLE); }
 
 	};
-
 	
+	
+	/** Loopback Throughput Benchmark of the Packet Layer. Defined in core/debug.cpp. **/
+	void BenchPackets();
 
 }
 
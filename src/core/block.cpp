@@ -22,21 +22,198 @@ using namespace boost;
 namespace Core
 {
 
-	uint1024 GetOrphanRoot(const CBlock* pblock)
+	COrphanBlockPool::~COrphanBlockPool()
 	{
-		// Work back to the first block in the orphan chain
-		while (mapOrphanBlocks.count(pblock->hashPrevBlock))
-			pblock = mapOrphanBlocks[pblock->hashPrevBlock];
-		return pblock->GetHash();
+		for (std::map<uint1024, COrphanBlock*>::iterator mi = mapOrphans.begin(); mi != mapOrphans.end(); ++mi)
+			delete mi->second;
 	}
-
-	uint1024 WantedByOrphan(const CBlock* pblockOrphan)
+	
+	
+	COrphanBlock* COrphanBlockPool::Root(COrphanBlock* pOrphan)
+	{
+		/** Start from the cached Root, or the Orphan itself if that Root was since Evicted. **/
+		std::map<uint1024, COrphanBlock*>::iterator mi = mapOrphans.find(pOrphan->hashRoot);
+		COrphanBlock* pRoot = (mi == mapOrphans.end()) ? pOrphan : mi->second;
+		
+		/** A Root stops being one once its previous Block arrives as an Orphan. Jump over the cached Root of that Orphan instead of walking Block by Block. **/
+		while ((mi = mapOrphans.find(pRoot->cBlock.hashPrevBlock)) != mapOrphans.end())
+		{
+			COrphanBlock* pPrev = mi->second;
+			std::map<uint1024, COrphanBlock*>::iterator ri = mapOrphans.find(pPrev->hashRoot);
+			
+			pRoot = (ri == mapOrphans.end()) ? pPrev : ri->second;
+		}
+		
+		pOrphan->hashRoot = pRoot->hash;
+		return pRoot;
+	}
+	
+	
+	void COrphanBlockPool::Erase(COrphanBlock* pOrphan)
 	{
-		// Work back to the first block in the orphan chain
-		while (mapOrphanBlocks.count(pblockOrphan->hashPrevBlock))
-			pblockOrphan = mapOrphanBlocks[pblockOrphan->hashPrevBlock];
-		return pblockOrphan->hashPrevBlock;
+		mapOrphans.erase(pOrphan->hash);
+		mapBySequence.erase(pOrphan->nSequence);
+		
+		std::pair<std::multimap<uint1024, COrphanBlock*>::iterator, std::multimap<uint1024, COrphanBlock*>::iterator> range = mapOrphansByPrev.equal_range(pOrphan->cBlock.hashPrevBlock);
+		for (std::multimap<uint1024, COrphanBlock*>::iterator mi = range.first; mi != range.second; ++mi)
+		{
+			if (mi->second == pOrphan)
+			{
+				mapOrphansByPrev.erase(mi);
+				break;
+			}
+		}
+		
+		std::map<uint64, COrphanBlock*>& mapPeer = mapByPeer[pOrphan->strPeer];
+		mapPeer.erase(pOrphan->nSequence);
+		if (mapPeer.empty())
+		{
+			mapByPeer.erase(pOrphan->strPeer);
+			mapPeerBytes.erase(pOrphan->strPeer);
+		}
+		else
+			mapPeerBytes[pOrphan->strPeer] -= pOrphan->nSize;
+			
+		nBytes -= pOrphan->nSize;
+	}
+	
+	
+	bool COrphanBlockPool::Add(const CBlock& cBlock, const uint1024& hash, const std::string& strPeer)
+	{
+		if (mapOrphans.count(hash))
+			return true;
+			
+		COrphanBlock* pOrphan = new COrphanBlock(cBlock, hash, strPeer, ::GetSerializeSize(cBlock, SER_NETWORK, PROTOCOL_VERSION), nSequence++);
+		mapOrphans[hash] = pOrphan;
+		mapOrphansByPrev.insert(make_pair(cBlock.hashPrevBlock, pOrphan));
+		mapBySequence[pOrphan->nSequence] = pOrphan;
+		mapByPeer[strPeer][pOrphan->nSequence] = pOrphan;
+		mapPeerBytes[strPeer] += pOrphan->nSize;
+		nBytes += pOrphan->nSize;
+		
+		/** Link into the Chain now. Orphans that arrived before this one pick up the new Root lazily through Root(). **/
+		Root(pOrphan);
+		
+		unsigned int nEvicted = Limit(strPeer, MAX_ORPHAN_BLOCK_BYTES, MAX_ORPHAN_BLOCK_PEER_BYTES);
+		if (nEvicted > 0)
+			printf("COrphanBlockPool::Add() : evicted %u orphan blocks, %u blocks %" PRI64u " bytes held\n", nEvicted, Size(), nBytes);
+			
+		return mapOrphans.count(hash);
+	}
+	
+	
+	uint1024 COrphanBlockPool::GetRoot(const uint1024& hash)
+	{
+		std::map<uint1024, COrphanBlock*>::iterator mi = mapOrphans.find(hash);
+		if (mi == mapOrphans.end())
+			return hash;
+			
+		return Root(mi->second)->hash;
+	}
+	
+	
+	uint1024 COrphanBlockPool::GetWanted(const uint1024& hash)
+	{
+		std::map<uint1024, COrphanBlock*>::iterator mi = mapOrphans.find(hash);
+		if (mi == mapOrphans.end())
+			return hash;
+			
+		return Root(mi->second)->cBlock.hashPrevBlock;
+	}
+	
+	
+	void COrphanBlockPool::TakeChildren(const uint1024& hashPrev, std::vector<COrphanBlock*>& vChildren)
+	{
+		std::pair<std::multimap<uint1024, COrphanBlock*>::iterator, std::multimap<uint1024, COrphanBlock*>::iterator> range = mapOrphansByPrev.equal_range(hashPrev);
+		for (std::multimap<uint1024, COrphanBlock*>::iterator mi = range.first; mi != range.second; ++mi)
+			vChildren.push_back(mi->second);
+			
+		BOOST_FOREACH(COrphanBlock* pOrphan, vChildren)
+			Erase(pOrphan);
+	}
+	
+	
+	unsigned int COrphanBlockPool::Limit(const std::string& strPeer, uint64 nMaxBytes, uint64 nMaxPeerBytes)
+	{
+		unsigned int nEvicted = 0;
+		
+		/** A Peer over its share loses its own Oldest Orphans first. **/
+		while (mapPeerBytes.count(strPeer) && mapPeerBytes[strPeer] > nMaxPeerBytes)
+		{
+			COrphanBlock* pOrphan = mapByPeer[strPeer].begin()->second;
+			Erase(pOrphan);
+			delete pOrphan;
+			
+			nEvicted++;
+		}
+		
+		/** Then the Pool as a whole sheds its Oldest Orphans. **/
+		while (nBytes > nMaxBytes && !mapBySequence.empty())
+		{
+			COrphanBlock* pOrphan = mapBySequence.begin()->second;
+			Erase(pOrphan);
+			delete pOrphan;
+			
+			nEvicted++;
+		}
+		
+		return nEvicted;
+	}
+	
+	
+	bool COrphanBlockPool::SelfTest()
+	{
+		COrphanBlockPool cPool;
+		
+		/** A Chain of six Orphans waiting on hashMissing, Added out of Order so cached Roots go stale as the Chain fills in. **/
+		uint1024 hashMissing = 1;
+		std::vector<CBlock> vBlocks(6);
+		std::vector<uint1024> vHashes(6);
+		for (unsigned int i = 0; i < vBlocks.size(); i++)
+		{
+			vBlocks[i].nChannel      = 2;
+			vBlocks[i].nHeight       = i + 1;
+			vBlocks[i].hashPrevBlock = (i == 0) ? hashMissing : vHashes[i - 1];
+			vHashes[i] = vBlocks[i].GetHash();
+		}
+		
+		const unsigned int nOrder[] = { 5, 3, 1, 4, 0, 2 };
+		BOOST_FOREACH(unsigned int i, nOrder)
+			if (!cPool.Add(vBlocks[i], vHashes[i], "selftest"))
+				return false;
+				
+		for (unsigned int i = 0; i < vBlocks.size(); i++)
+			if (cPool.GetRoot(vHashes[i]) != vHashes[0] || cPool.GetWanted(vHashes[i]) != hashMissing)
+				return false;
+				
+		/** Connecting the Missing Block hands back only the first Orphan, the rest now wait on it. **/
+		std::vector<COrphanBlock*> vChildren;
+		cPool.TakeChildren(hashMissing, vChildren);
+		
+		bool fChildren = (vChildren.size() == 1 && vChildren[0]->hash == vHashes[0]);
+		BOOST_FOREACH(COrphanBlock* pOrphan, vChildren)
+			delete pOrphan;
+			
+		if (!fChildren || cPool.Size() != 5)
+			return false;
+			
+		for (unsigned int i = 1; i < vBlocks.size(); i++)
+			if (cPool.GetRoot(vHashes[i]) != vHashes[1] || cPool.GetWanted(vHashes[i]) != vHashes[0])
+				return false;
+				
+		/** A Peer over its Byte Limit loses only its own Orphans. **/
+		CBlock cOther;
+		cOther.nChannel = 2;
+		cOther.hashPrevBlock = 2;
+		uint1024 hashOther = cOther.GetHash();
+		if (!cPool.Add(cOther, hashOther, "other"))
+			return false;
+			
+		cPool.Limit("selftest", std::numeric_limits<uint64>::max(), 0);
+		
+		return (cPool.Size() == 1 && cPool.Has(hashOther) && cPool.Bytes() == ::GetSerializeSize(cOther, SER_NETWORK, PROTOCOL_VERSION));
 	}
+	
 
 	const CBlockIndex* GetLastBlockIndex(const CBlockIndex* pindex, bool fProofOfStake)
 	{
@@ -379,10 +556,12 @@ namespace Core
 		hashBestChain = hash;
 		pindexBest = pindexNew;
 		nBestHeight = pindexBest->nHeight;
-		bnBestChainTrust = pindexNew->bnChainTrust;
+		nBestChainGeneration++;
+		nBestChainTrust = pindexNew->nChainTrust;
 		nTimeBestReceived = GetUnifiedTimestamp();
+		NotifyStakeMinter(true);
 		
-		printf("SetBestChain: new best=%s  height=%d  trust=%s  moneysupply=%s\n", hashBestChain.ToString().substr(0,20).c_str(), nBestHeight, bnBestChainTrust.ToString().c_str(), FormatMoney(pindexBest->nMoneySupply).c_str());
+		printf("SetBestChain: new best=%s  height=%d  trust=%" PRIu64 "  moneysupply=%s\n", hashBestChain.ToString().substr(0,20).c_str(), nBestHeight, nBestChainTrust.Get64(), FormatMoney(pindexBest->nMoneySupply).c_str());
 		
 		/** Grab the transactions for the block and set the address balances. **/
 		for(int nTx = 0; nTx < vtx.size(); nTx++)
@@ -464,7 +643,7 @@ namespace Core
 		
 		
 		/** Compute the Chain Trust **/
-		pindexNew->bnChainTrust = (pindexNew->pprev ? pindexNew->pprev->bnChainTrust : 0) + pindexNew->GetBlockTrust();
+		pindexNew->nChainTrust = (pindexNew->pprev ? pindexNew->pprev->nChainTrust : 0) + pindexNew->GetBlockTrust();
 		
 		
 		/** Compute the Channel Height. **/
@@ -509,6 +688,7 @@ namespace Core
 		/** Add to the MapBlockIndex **/
 		map<uint1024, CBlockIndex*>::iterator mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
 		pindexNew->phashBlock = &((*mi).first);
+		mapBlockPositions[make_pair(nFile, nBlockPos)] = pindexNew;
 
 
 		/** Write the new Block to Disk. **/
@@ -520,7 +700,7 @@ namespace Core
 			return false;
 
 		/** Set the Best chain if Highest Trust. **/
-		if (pindexNew->bnChainTrust > bnBestChainTrust)
+		if (pindexNew->nChainTrust > nBestChainTrust)
 			if (!SetBestChain(txdb, pindexNew))
 				return false;
 
@@ -594,7 +774,7 @@ namespace Core
 	
 	/** Check Block: These are Checks done before the Block is sunken in the Blockchain.
 		These are done before a block is orphaned to ensure it is valid before trying to obtain its chain. **/
-	bool CBlock::CheckBlock() const
+	bool CBlock::CheckBlock(bool fCheckWork) const
 	{
 		/** Check the Size limits of the Current Block. **/
 		if (vtx.empty() || vtx.size() > MAX_BLOCK_SIZE || ::GetSerializeSize(*this, SER_NETWORK, PROTOCOL_VERSION) > MAX_BLOCK_SIZE)
@@ -616,9 +796,9 @@ namespace Core
 			return DoS(50, error("CheckBlock() : Proof of Stake Blocks Rejected until Version 4."));
 			
 			
-		/** Check the Proof of Work Claims. **/
-		if (!IsInitialBlockDownload() && IsProofOfWork() && !VerifyWork())
-			return DoS(50, error("CheckBlock() : Invalid Proof of Work"));
+		/** Check the Proof of Work Claims. Skipped by the Message Workers since it depends on Chain State. **/
+		if (fCheckWork && !CheckBlockWork())
+			return false;
 
 			
 		/** Check the Network Launch Time-Lock. **/
@@ -754,6 +934,16 @@ namespace Core
 	}
 	
 	
+	/** Proof of Work Check of CheckBlock. Not done during the Initial Download, so it needs cs_main. **/
+	bool CBlock::CheckBlockWork() const
+	{
+		if (!IsInitialBlockDownload() && IsProofOfWork() && !VerifyWork())
+			return DoS(50, error("CheckBlock() : Invalid Proof of Work"));
+			
+		return true;
+	}
+	
+	
 	bool CBlock::AcceptBlock()
 	{
 		/** Check for Duplicate Block. **/
@@ -849,29 +1039,55 @@ namespace Core
 			return error("AcceptBlock() : AddToBlockIndex failed");
 
 			
-		/** Relay the Block to Nexus Network. **/
+		/** Relay the Block to Nexus Network. Peers that asked for Compact Blocks get one right away instead of an inv. **/
 		if (hashBestChain == hash)
 		{
+			Net::CInv inv(Net::MSG_BLOCK, hash);
+			bool fCompact = !IsInitialBlockDownload();
+			
+			boost::shared_ptr<CCompactBlock> pcompact;
+			map<int, Net::CSendBuffer> mapCompactMessages;
+			
 			LOCK(Net::cs_vNodes);
 			BOOST_FOREACH(Net::CNode* pnode, Net::vNodes)
-				pnode->PushInventory(Net::CInv(Net::MSG_BLOCK, hash));
+			{
+				if (!fCompact || !pnode->fPreferCompact)
+				{
+					pnode->PushInventory(inv);
+					continue;
+				}
+				
+				if (pnode->IsInventoryKnown(inv))
+					continue;
+					
+				/** Built once, and framed once per Protocol Version. **/
+				if (!pcompact)
+					pcompact.reset(new CCompactBlock(*this));
+					
+				Net::CSendBuffer& pmsg = mapCompactMessages[pnode->vSend.nVersion];
+				if (!pmsg)
+					pmsg = Net::MakeMessage("cmpctblock", *pcompact, pnode->vSend.nVersion);
+					
+				pnode->PushBuffer(pmsg);
+				pnode->AddInventoryKnown(inv);
+			}
 		}
 
 		return true;
 	}
 
 	
-	bool ProcessBlock(Net::CNode* pfrom, CBlock* pblock)
+	bool ProcessBlock(Net::CNode* pfrom, CBlock* pblock, bool fChecked)
 	{
 		// Check for duplicate
 		uint1024 hash = pblock->GetHash();
 		if (mapBlockIndex.count(hash))
 			return error("ProcessBlock() : already have block %d %s", mapBlockIndex[hash]->nHeight, hash.ToString().substr(0,20).c_str());
-		if (mapOrphanBlocks.count(hash))
+		if (cOrphanBlocks.Has(hash))
 			return error("ProcessBlock() : already have block (orphan) %s", hash.ToString().substr(0,20).c_str());
 
-		// Preliminary checks
-		if (!pblock->CheckBlock())
+		// Preliminary checks. fChecked means the context free part already passed on a Message Worker
+		if (fChecked ? !pblock->CheckBlockWork() : !pblock->CheckBlock())
 			return error("ProcessBlock() : CheckBlock FAILED");
 
 		// If don't already have its previous block, shunt it off to holding area until we get it
@@ -879,17 +1095,16 @@ namespace Core
 		{
 			printf("ProcessBlock: ORPHAN BLOCK, prev=%s\n", pblock->hashPrevBlock.ToString().substr(0,20).c_str());
 			
-			CBlock* pblock2 = new CBlock(*pblock);
-			mapOrphanBlocks.insert(make_pair(hash, pblock2));
-			mapOrphanBlocksByPrev.insert(make_pair(pblock2->hashPrevBlock, pblock2));
+			if (!cOrphanBlocks.Add(*pblock, hash, pfrom ? pfrom->addr.ToStringIP() : "local"))
+				return true;
 			
-			/** Simple Catch until I finish Checkpoint Syncing. **/
-			pfrom->PushGetBlocks(pindexBest, GetOrphanRoot(pblock2));
-
 			// Ask this guy to fill in what we're missing
 			if (pfrom)
-				pfrom->AskFor(Net::CInv(Net::MSG_BLOCK, WantedByOrphan(pblock2)));
-			
+			{
+				/** Simple Catch until I finish Checkpoint Syncing. **/
+				pfrom->PushGetBlocks(pindexBest, cOrphanBlocks.GetRoot(hash));
+				pfrom->AskFor(Net::CInv(Net::MSG_BLOCK, cOrphanBlocks.GetWanted(hash)));
+			}
 			
 			return true;
 		}
@@ -899,27 +1114,24 @@ namespace Core
 			return error("ProcessBlock() : AcceptBlock FAILED");
 
 
-		// Recursively process any orphan blocks that depended on this one
+		// Recursively process any orphan blocks that depended on this one. Orphans carry their hash, so none are hashed again here.
 		vector<uint1024> vWorkQueue;
 		vWorkQueue.push_back(hash);
 		for (unsigned int i = 0; i < vWorkQueue.size(); i++)
 		{
-			uint1024 hashPrev = vWorkQueue[i];
-			for (multimap<uint1024, CBlock*>::iterator mi = mapOrphanBlocksByPrev.lower_bound(hashPrev);
-				 mi != mapOrphanBlocksByPrev.upper_bound(hashPrev);
-				 ++mi)
+			vector<COrphanBlock*> vChildren;
+			cOrphanBlocks.TakeChildren(vWorkQueue[i], vChildren);
+			
+			BOOST_FOREACH(COrphanBlock* pOrphan, vChildren)
 			{
-				CBlock* pblockOrphan = (*mi).second;
-				if (pblockOrphan->AcceptBlock())
-					vWorkQueue.push_back(pblockOrphan->GetHash());
+				if (pOrphan->cBlock.AcceptBlock())
+					vWorkQueue.push_back(pOrphan->hash);
 					
-				mapOrphanBlocks.erase(pblockOrphan->GetHash());
-				delete pblockOrphan;
+				delete pOrphan;
 			}
-			mapOrphanBlocksByPrev.erase(hashPrev);
 		}
 
-		printg("ProcessBlock: ACCEPTED %s\n", pblock->GetHash().ToString().substr(0, 10).c_str());
+		printg("ProcessBlock: ACCEPTED %s\n", hash.ToString().substr(0, 10).c_str());
 
 		return true;
 	}
@@ -994,6 +1206,118 @@ namespace Core
 	}
 
 	
+	CCompactBlock::CCompactBlock(const CBlock& block) : nSalt(GetRand(std::numeric_limits<uint64>::max())), fKeys(false)
+	{
+		header.nVersion       = block.nVersion;
+		header.hashPrevBlock  = block.hashPrevBlock;
+		header.hashMerkleRoot = block.hashMerkleRoot;
+		header.nChannel       = block.nChannel;
+		header.nHeight        = block.nHeight;
+		header.nBits          = block.nBits;
+		header.nNonce         = block.nNonce;
+		header.nTime          = block.nTime;
+		header.vchBlockSig    = block.vchBlockSig;
+		
+		if (block.vtx.empty())
+			return;
+			
+		vPrefilled.push_back(make_pair(0u, block.vtx[0]));
+		
+		vShortIDs.reserve(block.vtx.size() - 1);
+		for (unsigned int i = 1; i < block.vtx.size(); i++)
+			vShortIDs.push_back(GetShortID(block.vtx[i].GetHash()));
+	}
+	
+	
+	/** 64 bit Finalizer, every Input Bit affects every Output Bit. **/
+	static inline uint64 MixShortID(uint64 x)
+	{
+		x ^= x >> 33;
+		x *= 0xff51afd7ed558ccdULL;
+		x ^= x >> 33;
+		x *= 0xc4ceb9fe1a85ec53ULL;
+		x ^= x >> 33;
+		
+		return x;
+	}
+	
+	
+	uint64 CCompactBlock::GetShortID(const uint512& hashTx) const
+	{
+		if (!fKeys)
+		{
+			uint1024 hashBlock = header.GetHash();
+			uint512 hashKey = SK512(BEGIN(hashBlock), END(hashBlock), BEGIN(nSalt), END(nSalt));
+			
+			k0 = hashKey.Get64(0);
+			k1 = hashKey.Get64(1);
+			fKeys = true;
+		}
+		
+		/** Chain every Word of the Transaction Hash through the Keyed Mix. **/
+		uint64 nShortID = k0;
+		for (int n = 0; n < 8; n++)
+			nShortID = MixShortID(nShortID ^ hashTx.Get64(n) ^ ((n & 1) ? k1 : k0));
+			
+		return nShortID;
+	}
+	
+	
+	bool CCompactBlock::SelfTest()
+	{
+		CBlock block;
+		block.nChannel = 2;
+		block.nHeight  = 1;
+		block.vtx.resize(8);
+		for (unsigned int i = 0; i < block.vtx.size(); i++)
+		{
+			block.vtx[i].vin.resize(1);
+			block.vtx[i].vout.resize(1);
+			block.vtx[i].nLockTime = i;
+		}
+		block.hashMerkleRoot = block.BuildMerkleTree();
+		
+		CCompactBlock cmpctblock(block);
+		if (cmpctblock.Size() != block.vtx.size() || cmpctblock.vPrefilled.size() != 1 || cmpctblock.vPrefilled[0].first != 0 ||
+			cmpctblock.vPrefilled[0].second.GetHash() != block.vtx[0].GetHash())
+			return false;
+			
+		/** The Receiver derives the Keys from the Header and Salt alone, so a Round Trip has to reproduce every ID. **/
+		CDataStream ssCompact(SER_NETWORK, PROTOCOL_VERSION);
+		ssCompact << cmpctblock;
+		
+		CCompactBlock cmpctReceived;
+		ssCompact >> cmpctReceived;
+		
+		std::set<uint64> setIDs;
+		for (unsigned int i = 1; i < block.vtx.size(); i++)
+		{
+			uint64 nShortID = cmpctReceived.GetShortID(block.vtx[i].GetHash());
+			if (nShortID != cmpctblock.vShortIDs[i - 1] || !setIDs.insert(nShortID).second)
+				return false;
+		}
+		
+		/** A new Salt gives new IDs for the same Block. **/
+		CCompactBlock cmpctResalted(block);
+		if (cmpctResalted.nSalt == cmpctblock.nSalt)
+			return false;
+			
+		return (cmpctResalted.vShortIDs != cmpctblock.vShortIDs);
+	}
+	
+	
+	/** Find the Block Index of the Block a Transaction Position points into. Returns NULL if the Block is not Indexed. **/
+	CBlockIndex* GetBlockIndexAt(const CDiskTxPos& pos)
+	{
+		LOCK(cs_main);
+		map<pair<unsigned int, unsigned int>, CBlockIndex*>::iterator mi = mapBlockPositions.find(make_pair(pos.nFile, pos.nBlockPos));
+		if (mi == mapBlockPositions.end())
+			return NULL;
+			
+		return (*mi).second;
+	}
+	
+	
 	FILE* OpenBlockFile(unsigned int nFile, unsigned int nBlockPos, const char* pszMode)
 	{
 		if (nFile == -1)
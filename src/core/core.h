@@ -32,7 +32,7 @@ class CDataStream;
 /** Net Namespace: Lowest Level Below Core Namespace. Handles all the raw
     Data through the network sockets in Nexus Network, and organizes
     into usable objects that are fed into the Core Namespace.	**/
-namespace Net { class CNode; }
+namespace Net { class CNode; class CNetMessage; }
 
 
 /** Wallet Namespace: Outer layer on top of Core Namespace.
@@ -67,6 +67,8 @@ namespace Core
 	class CTransaction;
 	class CTrustKey;
 	class CTxIndex;
+	class CDiskTxPos;
+	struct CMiningStats;
 	class COutPoint;
 	
 	
@@ -77,6 +79,8 @@ namespace Core
 	extern const unsigned int MAX_BLOCK_SIZE_GEN;
 	extern const unsigned int MAX_BLOCK_SIGOPS;
 	extern const unsigned int MAX_ORPHAN_TRANSACTIONS;
+	extern const unsigned int MAX_ORPHAN_BLOCK_BYTES;
+	extern const unsigned int MAX_ORPHAN_BLOCK_PEER_BYTES;
 	extern const unsigned int NEXUS_NETWORK_TIMELOCK;
 	extern const unsigned int NEXUS_TESTNET_TIMELOCK;
 	
@@ -128,12 +132,11 @@ namespace Core
 	/** BigNum Global Externals **/
 	extern CBigNum bnProofOfWorkLimit[];
 	extern CBigNum bnProofOfWorkStart[];
-	extern CBigNum bnBestChainTrust;
-	extern CBigNum bnBestInvalidTrust;
+	extern uint256 nBestChainTrust;
+	extern uint256 nBestInvalidTrust;
 
 	
 	/** Standard Library Global Externals **/
-	extern std::map<uint1024, CBlock*> mapOrphanBlocks;
 	
 	/** Map to keep track of the addresses and their corresponding Transactions. **/
 	extern std::map<uint256, uint64> mapAddressTransactions;
@@ -141,11 +144,13 @@ namespace Core
 	/** The "Block Chain" or index of the chain linking each block to its previous block. **/
 	extern std::map<uint1024, CBlockIndex*> mapBlockIndex;
 	
+	/** Block Index by the Position of the Block on Disk (nFile, nBlockPos). Resolves a Transaction Index to its Block without Disk Reads. **/
+	extern std::map<std::pair<unsigned int, unsigned int>, CBlockIndex*> mapBlockPositions;
+	
 	extern std::map<uint1024, uint1024> mapProofOfStake;
 	extern std::map<uint512, CDataStream*> mapOrphanTransactions;
 	extern std::map<uint512, std::map<uint512, CDataStream*> > mapOrphanTransactionsByPrev;
 	extern std::set<Wallet::CWallet*> setpwalletRegistered;
-	extern std::multimap<uint1024, CBlock*> mapOrphanBlocksByPrev;
 	extern std::string strMintMessage;
 	extern std::string strMintWarning;
 	
@@ -161,6 +166,9 @@ namespace Core
 	extern unsigned int nCurrentBlockFile;
 	extern unsigned int nBestHeight;
 	
+	/** Incremented each time the best chain changes. Lets cached chain depths know when they are stale. **/
+	extern unsigned int nBestChainGeneration;
+	
 	
 	/** Reporting Constant for Current Weight. **/
 	extern double dTrustWeight;
@@ -193,19 +201,18 @@ namespace Core
 	/**************************************** CORE FUNCTION REFERENCES ****************************************/
 	
 	/**  BLOCK.CPP **/
-	uint1024 GetOrphanRoot(const CBlock* pblock);
-	uint1024 WantedByOrphan(const CBlock* pblockOrphan);
 	int64 GetProofOfWorkReward(unsigned int nBits);
 	int64 GetProofOfStakeReward(int64 nCoinAge);
 	const CBlockIndex* GetLastBlockIndex(const CBlockIndex* pindex, bool fProofOfStake);
 	const CBlockIndex* GetLastChannelIndex(const CBlockIndex* pindex, int nChannel);
 	int GetNumBlocksOfPeers();
 	bool IsInitialBlockDownload();
-	bool ProcessBlock(Net::CNode* pfrom, CBlock* pblock);
+	bool ProcessBlock(Net::CNode* pfrom, CBlock* pblock, bool fChecked = false);
 	bool CheckDiskSpace(uint64 nAdditionalBytes = 0);
 	FILE* OpenBlockFile(unsigned int nFile, unsigned int nBlockPos, const char* pszMode);
 	FILE* AppendBlockFile(unsigned int& nFileRet);
 	bool LoadBlockIndex(bool fAllowNew = true);
+	CBlockIndex* GetBlockIndexAt(const CDiskTxPos& pos);
 	
 	
 	/** DISPATCH.CPP **/
@@ -241,19 +248,26 @@ namespace Core
 	/** MESSAGE.CPP **/
 	std::string GetWarnings(std::string strFor);
 	bool AlreadyHave(Wallet::CTxDB& txdb, const Net::CInv& inv);
-	bool ProcessMessage(Net::CNode* pfrom, std::string strCommand, CDataStream& vRecv);
+	bool ProcessMessage(Net::CNode* pfrom, Net::CNetMessage& msg);
 	bool ProcessMessages(Net::CNode* pfrom);
-	bool SendMessages(Net::CNode* pto, bool fSendTrickle);
+	void ThreadMessageWorker(void* parg);
+	bool SendMessages(Net::CNode* pto);
+	void BenchRelay(unsigned int nPeers, unsigned int nTransactions);
 	
 	
 	/** MINING.CPP **/
 	void StartMiningLLP();
+	void StopMiningLLP();
+	bool SelfTestTestPoolView();
+	void BenchTestPool(unsigned int nCandidates);
 	void StartStaking(Wallet::CWallet *pwallet);
 	CBlock* CreateNewBlock(Wallet::CReserveKey& reservekey, Wallet::CWallet* pwallet, unsigned int nChannel, unsigned int nID = 1, LLP::Coinbase* pCoinbase = NULL);
 	void AddTransactions(std::vector<CTransaction>& vtx, CBlockIndex* pindexPrev);
 	
 	bool CheckWork(CBlock* pblock, Wallet::CWallet& wallet, Wallet::CReserveKey& reservekey);
 	void StakeMinter(void* parg);
+	void NotifyStakeMinter(bool fNewTip);
+	void GetMiningStats(std::vector<CMiningStats>& vStats);
 	std::string GetChannelName(int nChannel);
 	
 	
@@ -284,7 +298,10 @@ namespace Core
 	bool AddOrphanTx(const CDataStream& vMsg);
 	void EraseOrphanTx(uint512 hash);
 	unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans);
+	bool DumpMempool();
+	bool LoadMempool();
 	bool GetTransaction(const uint512 &hash, CTransaction &tx, uint1024 &hashBlock);
+	bool SelfTestDepthCache();
 
 
 	
@@ -609,6 +626,9 @@ namespace Core
 		/** Previous Blocks Vector to store list of blocks of this Trust Key. **/
 		mutable std::vector<uint1024> hashPrevBlocks;
 		
+		/** Memory Only: Set once the Genesis Coinstake has been verified so Trust Blocks don't re-read the Genesis Block. **/
+		mutable bool fGenesisVerified;
+		
 		
 		CTrustKey() { SetNull(); }
 		CTrustKey(std::vector<unsigned char> vchPubKeyIn, uint1024 hashBlockIn, uint512 hashTxIn, unsigned int nTimeIn)
@@ -628,6 +648,7 @@ namespace Core
 			hashGenesisBlock     = 0;
 			hashGenesisTx        = 0;
 			nGenesisTime         = 0;
+			fGenesisVerified     = false;
 			
 			hashPrevBlocks.clear();
 			vchPubKey.clear();
@@ -659,7 +680,7 @@ namespace Core
 		/** Flag to Determine if Class is Empty and Null. **/
 		bool IsNull()  const { return (hashGenesisBlock == 0 || hashGenesisTx == 0 || nGenesisTime == 0 || vchPubKey.empty()); }
 		bool Expired(unsigned int nTime) const;
-		bool CheckGenesis(CBlock cBlock) const;
+		bool CheckGenesis(const CBlock& cBlock) const;
 		
 		void Print()
 		{
@@ -676,17 +697,26 @@ namespace Core
 	private:
 		mutable CCriticalSection cs;
 		mutable std::map<uint576, CTrustKey> mapTrustKeys;
+		
+		/** Keys in the Pool Owned by the Main Wallet. Built on first use, then kept by Accept, Remove and AddWalletKey. **/
+		std::set<uint576> setWalletKeys;
+		bool fWalletIndexed;
 
 	public:
 		/** The Trust Key Owned By Current Node. **/
 		std::vector<unsigned char>   vchTrustKey;
 		
+		CTrustPool() : fWalletIndexed(false) { }
+		
 		/** Helper Function to Find Trust Key. **/
 		bool HasTrustKey(unsigned int nTime);
 		
-		bool Check(CBlock cBlock);
-		bool Accept(CBlock cBlock, bool fInit = false);
-		bool Remove(CBlock cBlock);
+		/** Called when a Key is Added to a Wallet in case it Owns a Trust Key already in the Pool. **/
+		void AddWalletKey(const Wallet::CWallet* pwallet, const std::vector<unsigned char>& vchPubKey);
+		
+		bool Check(const CBlock& cBlock);
+		bool Accept(const CBlock& cBlock, bool fInit = false);
+		bool Remove(const CBlock& cBlock);
 		
 		bool Exists(uint576 cKey)    const { return mapTrustKeys.count(cKey); }
 		bool IsGenesis(uint576 cKey) const { return mapTrustKeys[cKey].hashPrevBlocks.empty(); }
@@ -1061,7 +1091,7 @@ namespace Core
 		}
 
 
-		bool GetCoinstakeInterest(Wallet::CTxDB& txdb, int64& nInterest) const;
+		bool GetCoinstakeInterest(const MapPrevTx& inputs, int64& nInterest) const;
 		bool GetCoinstakeAge(Wallet::CTxDB& txdb, uint64& nAge) const;
 
 		
@@ -1086,7 +1116,7 @@ namespace Core
 		/** Sanity check previous transactions, then, if all checks succeed,
 			mark them as spent by this transaction.
 
-			@param[in] inputs	Previous transactions (from FetchInputs)
+			@param[in,out] inputs	Previous transactions (from FetchInputs). Spent pointers are marked in place
 			@param[out] mapTestPool	Keeps track of inputs that need to be updated on disk
 			@param[in] posThisTx	Position of this transaction on disk
 			@param[in] pindexBlock
@@ -1095,7 +1125,7 @@ namespace Core
 			@param[in] fStrictPayToScriptHash	true if fully validating p2sh transactions
 			@return Returns true if all checks succeed
 		 */
-		bool ConnectInputs(Wallet::CTxDB& txdb, MapPrevTx inputs,
+		bool ConnectInputs(Wallet::CTxDB& txdb, MapPrevTx& inputs,
 						   std::map<uint512, CTxIndex>& mapTestPool, const CDiskTxPos& posThisTx,
 						   const CBlockIndex* pindexBlock, bool fBlock, bool fMiner);
 		bool ClientConnectInputs();
@@ -1118,6 +1148,13 @@ namespace Core
 
 		// memory only
 		mutable bool fMerkleVerified;
+		
+		/** Depth cache, valid while nBestChainGeneration and the block location are unchanged. **/
+		mutable int nDepthCached;
+		mutable unsigned int nDepthGeneration;
+		mutable uint1024 hashDepthBlock;
+		mutable int nDepthIndex;
+		mutable CBlockIndex* pindexDepthCached;
 
 
 		CMerkleTx()
@@ -1135,6 +1172,9 @@ namespace Core
 			hashBlock = 0;
 			nIndex = -1;
 			fMerkleVerified = false;
+			nDepthGeneration = 0;
+			hashDepthBlock = 0;
+			nDepthIndex = -1;
 		}
 
 
@@ -1508,7 +1548,8 @@ namespace Core
 		bool ReadFromDisk(const CBlockIndex* pindex, bool fReadTransactions=true);
 		bool SetBestChain(Wallet::CTxDB& txdb, CBlockIndex* pindexNew);
 		bool AddToBlockIndex(unsigned int nFile, unsigned int nBlockPos);
-		bool CheckBlock() const;
+		bool CheckBlock(bool fCheckWork = true) const;
+		bool CheckBlockWork() const;
 		
 		bool VerifyWork() const;
 		bool VerifyStake() const;
@@ -1537,7 +1578,7 @@ namespace Core
 		unsigned int nFile;
 		unsigned int nBlockPos;
 		
-		CBigNum bnChainTrust; // Nexus: trust score of block chain
+		uint256 nChainTrust; // Nexus: trust score of block chain, fixed width to avoid heap allocated arithmetic
 		int64 nMint;
 		int64 nMoneySupply;
 		int64 nChannelHeight;
@@ -1580,7 +1621,7 @@ namespace Core
 			nFile = 0;
 			nBlockPos = 0;
 			
-			bnChainTrust = 0;
+			nChainTrust = 0;
 			nMint = 0;
 			nMoneySupply = 0;
 			nFlags = 0;
@@ -1606,7 +1647,7 @@ namespace Core
 			pnext = NULL;
 			nFile = nFileIn;
 			nBlockPos = nBlockPosIn;
-			bnChainTrust = 0;
+			nChainTrust = 0;
 			nMint = 0;
 			nMoneySupply = 0;
 			nStakeModifier = 0;
@@ -1668,7 +1709,7 @@ namespace Core
 			return (int64)nTime;
 		}
 
-		CBigNum GetBlockTrust() const
+		uint256 GetBlockTrust() const
 		{
 				
 			/** Give higher block trust if last block was of different channel **/
@@ -1940,18 +1981,251 @@ namespace Core
 
 
 
+	/** A Block announced by its Header and a short Salted ID per Transaction, for Peers that already hold most of its
+		Transactions in their Memory Pool. The first Transaction (Coinbase or Coinstake) is always sent in full. **/
+	class CCompactBlock
+	{
+	public:
+		/** Header and Block Signature. vtx stays empty. **/
+		CBlock header;
+		uint64 nSalt;
+		
+		/** Short IDs of the Transactions not Prefilled, in Block order, and the Prefilled ones with their Block Index. **/
+		std::vector<uint64> vShortIDs;
+		std::vector< std::pair<unsigned int, CTransaction> > vPrefilled;
+		
+		IMPLEMENT_SERIALIZE
+		(
+			READWRITE(header);
+			READWRITE(nSalt);
+			READWRITE(vShortIDs);
+			READWRITE(vPrefilled);
+		)
+		
+		CCompactBlock() : nSalt(0), fKeys(false) { }
+		CCompactBlock(const CBlock& block);
+		
+		unsigned int Size() const { return vShortIDs.size() + vPrefilled.size(); }
+		
+		/** Short ID of a Transaction Hash. Keyed by the Block Hash and Salt, so IDs cannot be ground before the Block is announced. **/
+		uint64 GetShortID(const uint512& hashTx) const;
+		
+		/** Self-check of Prefilling, Short ID Round Trips, and Salting. **/
+		static bool SelfTest();
+		
+	private:
+		mutable bool fKeys;
+		mutable uint64 k0, k1;
+	};
+	
+	
+	/** Transactions of a Compact Block the receiving Peer could not find in its Memory Pool, by Block Index. **/
+	class CBlockTxRequest
+	{
+	public:
+		uint1024 hashBlock;
+		std::vector<unsigned int> vIndexes;
+		
+		IMPLEMENT_SERIALIZE
+		(
+			READWRITE(hashBlock);
+			READWRITE(vIndexes);
+		)
+	};
+	
+	
+	/** Answer to a CBlockTxRequest, Transactions in the order they were requested. **/
+	class CBlockTxResponse
+	{
+	public:
+		uint1024 hashBlock;
+		std::vector<CTransaction> vtx;
+		
+		IMPLEMENT_SERIALIZE
+		(
+			READWRITE(hashBlock);
+			READWRITE(vtx);
+		)
+	};
+	
+	
+	/** Block held back until its previous Block is known. Keeps its Hash so the Pool never has to hash it again. **/
+	class COrphanBlock
+	{
+	public:
+		CBlock       cBlock;
+		uint1024     hash;
+		
+		/** Cached first Block of the Orphan Chain. Only refreshed when COrphanBlockPool walks the Chain. **/
+		uint1024     hashRoot;
+		
+		/** Peer that relayed the Block, its Serialized Size, and its Arrival Order for Eviction. **/
+		std::string  strPeer;
+		unsigned int nSize;
+		uint64       nSequence;
+		
+		COrphanBlock(const CBlock& cBlockIn, const uint1024& hashIn, const std::string& strPeerIn, unsigned int nSizeIn, uint64 nSequenceIn) :
+			cBlock(cBlockIn), hash(hashIn), hashRoot(hashIn), strPeer(strPeerIn), nSize(nSizeIn), nSequence(nSequenceIn) { }
+	};
+	
+	
+	/** Memory Bounded Holding Area for Orphan Blocks. Bytes are accounted per Peer so a single Peer cannot fill the Pool,
+		and the Oldest Orphans are Evicted first. Guarded by cs_main. **/
+	class COrphanBlockPool
+	{
+	private:
+		std::map<uint1024, COrphanBlock*> mapOrphans;
+		std::multimap<uint1024, COrphanBlock*> mapOrphansByPrev;
+		
+		/** Orphans in Arrival Order, across the whole Pool and per Peer. **/
+		std::map<uint64, COrphanBlock*> mapBySequence;
+		std::map<std::string, std::map<uint64, COrphanBlock*> > mapByPeer;
+		std::map<std::string, uint64> mapPeerBytes;
+		
+		uint64 nBytes, nSequence;
+		
+		COrphanBlock* Root(COrphanBlock* pOrphan);
+		void Erase(COrphanBlock* pOrphan);
+		
+	public:
+		COrphanBlockPool() : nBytes(0), nSequence(0) { }
+		~COrphanBlockPool();
+		
+		bool Has(const uint1024& hash) const { return mapOrphans.count(hash); }
+		unsigned int Size() const { return mapOrphans.size(); }
+		uint64 Bytes() const { return nBytes; }
+		
+		/** Add a Block to the Pool, then Evict until the Peer and the Pool are within their Byte Limits. Returns false if the Block itself was Evicted. **/
+		bool Add(const CBlock& cBlock, const uint1024& hash, const std::string& strPeer);
+		
+		/** First Block of the Orphan Chain containing hash, and the Block that Chain is waiting for. **/
+		uint1024 GetRoot(const uint1024& hash);
+		uint1024 GetWanted(const uint1024& hash);
+		
+		/** Remove the Orphans whose previous Block is hashPrev. Ownership passes to the Caller. **/
+		void TakeChildren(const uint1024& hashPrev, std::vector<COrphanBlock*>& vChildren);
+		
+		/** Evict Oldest Orphans of strPeer over nMaxPeerBytes, then Oldest Orphans of the Pool over nMaxBytes. **/
+		unsigned int Limit(const std::string& strPeer, uint64 nMaxBytes, uint64 nMaxPeerBytes);
+		
+		/** Self-check of cached Roots as a Chain fills in and is Connected, and of Eviction per Peer. **/
+		static bool SelfTest();
+	};
+	
+	extern COrphanBlockPool cOrphanBlocks;
+	
+	
+
+	/** Memory Pool Bookkeeping for one Transaction. Input Values, Fee and Dependency Links are resolved once when the
+		Transaction enters the Pool, so Block Assembly can order it without reading its Inputs from Disk. **/
+	class CTxMemPoolEntry
+	{
+	public:
+		CTransaction* ptx;
+		uint512       hash;
+		unsigned int  nSize;
+		int64         nFee;
+		int64         nTime;
+		
+		/** Value of the Inputs already in the Main Chain, and that Value weighted by the Height of each Input. **/
+		int64         nChainValueIn;
+		double        dChainValueHeight;
+		
+		/** Priority when the Transaction entered the Pool. Breaks ties between equal Fee Rates. **/
+		double        dEntryPriority;
+		
+		/** Transactions in the Pool this one spends, and those spending it. **/
+		std::set<CTxMemPoolEntry*> setParents;
+		std::set<CTxMemPoolEntry*> setChildren;
+		
+		/** Totals over this Transaction and every Ancestor still in the Pool. **/
+		unsigned int  nCountWithAncestors;
+		uint64        nSizeWithAncestors;
+		int64         nFeesWithAncestors;
+		
+		/** Estimated Heap held by the Transaction and its Pool Indexes. **/
+		uint64        nUsage;
+		
+		CTxMemPoolEntry() : ptx(NULL), nSize(0), nFee(0), nTime(0), nChainValueIn(0), dChainValueHeight(0), dEntryPriority(0),
+			nCountWithAncestors(1), nSizeWithAncestors(0), nFeesWithAncestors(0), nUsage(0) { }
+		
+		/** Priority is sum(valuein * age) / txsize, with the age of each Input counted in Confirmations at nHeight. **/
+		double GetPriority(unsigned int nHeight) const
+		{
+			return ((double)nChainValueIn * (nHeight + 1) - dChainValueHeight) / nSize;
+		}
+		
+		double GetAncestorFeeRate() const { return (double)nFeesWithAncestors / nSizeWithAncestors; }
+	};
+	
+	
+	/** Block Assembly order: best Ancestor Package Fee Rate, then highest Entry Priority, then Oldest. **/
+	struct CTxMemPoolScoreCompare
+	{
+		bool operator()(const CTxMemPoolEntry* a, const CTxMemPoolEntry* b) const
+		{
+			double dRateA = a->GetAncestorFeeRate(), dRateB = b->GetAncestorFeeRate();
+			if (dRateA != dRateB)
+				return dRateA > dRateB;
+				
+			if (a->dEntryPriority != b->dEntryPriority)
+				return a->dEntryPriority > b->dEntryPriority;
+				
+			if (a->nTime != b->nTime)
+				return a->nTime < b->nTime;
+				
+			return a->hash < b->hash;
+		}
+	};
+	
+	
+
 	class CTxMemPool
 	{
 	public:
 		mutable CCriticalSection cs;
 		std::map<uint512, CTransaction> mapTx;
 		std::map<COutPoint, CInPoint> mapNextTx;
+		
+		/** Entries by Transaction Hash, by Block Assembly Score, and by Arrival Time. Kept in step with mapTx. **/
+		std::map<uint512, CTxMemPoolEntry> mapEntry;
+		std::set<CTxMemPoolEntry*, CTxMemPoolScoreCompare> setByScore;
+		std::set<std::pair<int64, uint512> > setByTime;
+		
+		CTxMemPool() : nTotalUsage(0) { }
 
 		bool accept(Wallet::CTxDB& txdb, CTransaction &tx,
 					bool fCheckInputs, bool* pfMissingInputs);
-		bool addUnchecked(CTransaction &tx);
+		bool addUnchecked(CTransaction &tx, const MapPrevTx& mapInputs = MapPrevTx());
 		bool remove(CTransaction &tx);
 		void queryHashes(std::vector<uint512>& vtxid);
+		
+		/** Entries for a new Block in Dependency Order, best Ancestor Package first, until nMaxSize Bytes are used. **/
+		void SelectForBlock(std::vector<CTxMemPoolEntry*>& vSelected, uint64 nMaxSize);
+		
+		/** Evict the lowest Fee Rate Packages, with their Descendants, until the Pool uses at most nMaxUsage Bytes. **/
+		unsigned int TrimToSize(uint64 nMaxUsage);
+		
+		uint64 DynamicUsage() const
+		{
+			LOCK(cs);
+			return nTotalUsage;
+		}
+		
+		/** Self-check of Ancestor Package Scoring, Selection Order, and Trimming on a private Pool. **/
+		static bool SelfTest();
+		
+	private:
+		uint64 nTotalUsage;
+		
+		void CalculateAncestors(CTxMemPoolEntry* pentry, std::set<CTxMemPoolEntry*>& setAncestors);
+		void CalculateDescendants(CTxMemPoolEntry* pentry, std::set<CTxMemPoolEntry*>& setDescendants);
+		void UpdateAncestorState(CTxMemPoolEntry* pentry);
+		
+		/** Insert and Link an Entry, with its Input Values already resolved. Requires cs. **/
+		void AddEntry(CTransaction &tx, int64 nFee, int64 nChainValueIn, double dChainValueHeight);
+		
+	public:
 
 		unsigned long size()
 		{
@@ -1971,6 +2245,18 @@ namespace Core
 	};
 
 	extern CTxMemPool mempool;
+	
+	
+	/** Share and Hashrate Counters of a Mining LLP Worker Connection. **/
+	struct CMiningStats
+	{
+		std::string strAddress;
+		unsigned int nChannel, nConnected;
+		uint64 nShares, nRejected, nBlocks;
+		
+		/** Accepted Shares per Second, Estimated Hashes per Second [Hash Channel], and Average Share Difficulty [Prime Channel]. **/
+		double dShareRate, dHashRate, dDifficulty;
+	};
 
 }
 #endif
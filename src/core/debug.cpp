@@ -47,6 +47,76 @@ namespace LLP
 			this->WritePacket(PACKET);
 		}
 	};
+	
+	
+	/** Writer side of the Packet Benchmark. **/
+	static void BenchWrite(Connection* pWriter, Packet* pPacket, unsigned int nPackets, boost::atomic<unsigned int>* pnReceived, boost::atomic<bool>* pfStop)
+	{
+		for(unsigned int nPacket = 0; nPacket < nPackets; nPacket++)
+		{
+			/** Stay within a Window of the Reader. A Reader waiting on a partial Length with the Socket Buffers full
+				stalls until the next Zero Window Probe, which would be timed instead of the Packet Layer. **/
+			while(nPacket - *pnReceived > 256 && !*pfStop)
+				boost::this_thread::yield();
+				
+			if(*pfStop)
+				return;
+				
+			pWriter->WritePacket(*pPacket);
+		}
+	}
+	
+	
+	/** Loopback Throughput of the Packet Layer. Data Packets go through WritePacket on one Connection and are
+		rebuilt by ReadPacket on the other, as a Server Data Thread would. Run with -bench=llp. **/
+	void BenchPackets()
+	{
+		const unsigned int nSizes[] = { 64, 20000, 1000000 };
+		const unsigned int nTotal   = 200000000;
+		
+		for(int nTest = 0; nTest < 3; nTest++)
+		{
+			using boost::asio::ip::tcp;
+			
+			Service_t IO_SERVICE;
+			Listener_t LISTENER(IO_SERVICE, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+			
+			Socket_t SOCKET_OUT(new tcp::socket(IO_SERVICE)), SOCKET_IN(new tcp::socket(IO_SERVICE));
+			SOCKET_OUT->connect(LISTENER.local_endpoint());
+			LISTENER.accept(*SOCKET_IN);
+			
+			Connection WRITER(SOCKET_OUT, NULL), READER(SOCKET_IN, NULL);
+			
+			Packet PACKET;
+			PACKET.HEADER = 0;
+			PACKET.LENGTH = nSizes[nTest];
+			PACKET.DATA.resize(nSizes[nTest], 0xAA);
+			
+			unsigned int nPackets = std::min(std::max(nTotal / nSizes[nTest], 100u), 100000u);
+			boost::atomic<unsigned int> nReceived(0);
+			boost::atomic<bool> fStop(false);
+			int64 nStart = GetTimeMillis();
+			
+			Thread_t WRITE_THREAD(boost::bind(&BenchWrite, &WRITER, &PACKET, nPackets, &nReceived, &fStop));
+			while(nReceived < nPackets && !READER.Errors())
+			{
+				READER.ReadPacket();
+				if(READER.PacketComplete())
+				{
+					READER.ResetPacket();
+					nReceived++;
+				}
+			}
+			
+			/** The Writer gives up with the Reader, and is never left waiting on it. **/
+			fStop = true;
+			WRITE_THREAD.join();
+			
+			int64 nMillis = std::max(GetTimeMillis() - nStart, (int64)1);
+			printf("bench llp: %u packets of %u bytes in %" PRI64d " ms, %.0f packets/s, %.1f MB/s%s\n", (unsigned int)nReceived, nSizes[nTest], nMillis,
+				nReceived * 1000.0 / nMillis, (double)nReceived * nSizes[nTest] / 1000.0 / nMillis, READER.Errors() ? " (connection error)" : "");
+		}
+	}
 }
 
 /** Thread to handle Debugging Server Reporting. **/
@@ -32,6 +32,10 @@ namespace Core
 	const unsigned int MAX_BLOCK_SIGOPS = MAX_BLOCK_SIZE/50;
 	const unsigned int MAX_ORPHAN_TRANSACTIONS = MAX_BLOCK_SIZE/100;
 	
+	/** Orphan Blocks are held in at most 64 MB, with no single Peer holding more than a quarter of it. **/
+	const unsigned int MAX_ORPHAN_BLOCK_BYTES = MAX_BLOCK_SIZE * 32;
+	const unsigned int MAX_ORPHAN_BLOCK_PEER_BYTES = MAX_ORPHAN_BLOCK_BYTES / 4;
+	
 	/** Nexus Transactions are Free for Everyone. **/
 	const int64 MIN_TX_FEE = CENT;
 	const int64 MIN_RELAY_TX_FEE = CENT;
@@ -186,10 +190,16 @@ namespace Core
 	
 	/** Trust Key Holding Structure To Verify Trust Keys Seen on Blockchain. **/
 	CTrustPool cTrustPool;
+	
+	/** Blocks waiting on their previous Block. **/
+	COrphanBlockPool cOrphanBlocks;
 
 	/** In memory Indexing of Blocks into Blockchain. **/
 	map<uint1024, CBlockIndex*> mapBlockIndex;
 	
+	/** In memory Indexing of Blocks by their Position on Disk. **/
+	map<pair<unsigned int, unsigned int>, CBlockIndex*> mapBlockPositions;
+	
 	/** In Memory Holdings of each Address Balance. **/
 	map<uint256, uint64>   mapAddressTransactions;
 	
@@ -204,8 +214,9 @@ namespace Core
 	int nCoinbaseMaturity = COINBASE_MATURITY;
 	CBlockIndex* pindexGenesisBlock = NULL;
 	unsigned int nBestHeight = 0;
-	CBigNum bnBestChainTrust = 0;
-	CBigNum bnBestInvalidTrust = 0;
+	unsigned int nBestChainGeneration = 1;
+	uint256 nBestChainTrust = 0;
+	uint256 nBestInvalidTrust = 0;
 	uint1024 hashBestChain = 0;
 	CBlockIndex* pindexBest = NULL;
 	int64 nTimeBestReceived = 0;
@@ -222,8 +233,6 @@ namespace Core
 
 	CMajority<int> cPeerBlockCounts; // Amount of blocks that other nodes claim to have
 
-	map<uint1024, CBlock*> mapOrphanBlocks;
-	multimap<uint1024, CBlock*> mapOrphanBlocksByPrev;
 	map<uint1024, uint1024> mapProofOfStake;
 
 	map<uint512, CDataStream*> mapOrphanTransactions;
@@ -22,41 +22,29 @@ namespace Wallet
 
 	bool CWallet::AddCoinstakeInputs(Core::CTransaction& txNew)
 	{
-		int64 nBalance = GetBalance();
 		int64 nReserveBalance = 0, nTotalValue = 0;
 		if (mapArgs.count("-reservebalance") && !ParseMoney(mapArgs["-reservebalance"], nReserveBalance))
 			return false;
 			
-		/** Check the Balance to Reserve Balance. **/
-		if (nBalance <= nReserveBalance)
-			return false;
-			
-		/** Select Coins to Add Inputs. **/
-		set<pair<const CWalletTx*,unsigned int> > setCoins;
-		if (!SelectCoins(nBalance - nReserveBalance, txNew.nTime, setCoins, nTotalValue))
-			return false;
-			
-		/** Return Error if no Coins Selected. **/
-		if (setCoins.empty())
+		/** Select Coins to Add Inputs. Fails if the Stakeable Balance is within the Reserve Balance. **/
+		vector<pair<const CWalletTx*,unsigned int> > vCoins;
+		if (!SelectStakeCoins(nReserveBalance, txNew.nTime, vCoins, nTotalValue))
 			return false;
 			
 		/** Add Each Input to Transaction. **/
 		vector<const CWalletTx*> vInputs;
+		Core::MapPrevTx mapInputs;
 		txNew.vout[0].nValue = 0;
 			
 		CTxDB txdb("r");
-		BOOST_FOREACH(PAIRTYPE(const CWalletTx*, unsigned int) pcoin, setCoins)
+		BOOST_FOREACH(PAIRTYPE(const CWalletTx*, unsigned int) pcoin, vCoins)
 		{
-			if(txNew.vout[0].nValue > Core::MAX_STAKE_WEIGHT || txNew.vout[0].nValue > nBalance - nReserveBalance)
-				break;
-			
 			Core::CTxIndex txindex;
 			if (!txdb.ReadTxIndex(pcoin.first->GetHash(), txindex))
 				continue;
 			
 			/** Get the Block where the Transaction Originates from. **/
-			Core::CBlock block;
-			if (!block.ReadFromDisk(txindex.pos.nFile, txindex.pos.nBlockPos, false))
+			if (!Core::GetBlockIndexAt(txindex.pos))
 				continue;
 			
 			/** Stop adding Inputs if has reached Maximum Transaction Size. **/
@@ -67,6 +55,10 @@ namespace Wallet
 			txNew.vin.push_back(Core::CTxIn(pcoin.first->GetHash(), pcoin.second));
 			vInputs.push_back(pcoin.first);
 			
+			/** The Wallet already holds the Previous Transaction, so the Interest needs no Disk Reads. **/
+			if (!mapInputs.count(pcoin.first->GetHash()))
+				mapInputs[pcoin.first->GetHash()] = make_pair(txindex, (Core::CTransaction)*pcoin.first);
+			
 			/** Add the value to the first Output for Coinstake. **/
 			txNew.vout[0].nValue += pcoin.first->vout[pcoin.second].nValue;
 		}
@@ -74,7 +66,7 @@ namespace Wallet
 			
 		/** Set the Interest for the Coinstake Transaction. **/
 		int64 nInterest;
-		if(!txNew.GetCoinstakeInterest(txdb, nInterest))
+		if(!txNew.GetCoinstakeInterest(mapInputs, nInterest))
 		{
 			txdb.Close();
 			
@@ -216,20 +208,19 @@ namespace Core
 		/** Check the coin age of each Input. **/
 		for(int nIndex = 1; nIndex < vin.size(); nIndex++)
 		{
-			CTransaction txPrev;
 			CTxIndex txindex;
 			
 			/** Ignore Outputs that are not in the Main Chain. **/
-			if (!txPrev.ReadFromDisk(txdb, vin[nIndex].prevout, txindex))
+			if (!txdb.ReadTxIndex(vin[nIndex].prevout.hash, txindex))
 				return error("GetCoinstakeAge() : Invalid Previous Transaction");
 
-			/** Read the Previous Transaction's Block from Disk. **/
-			CBlock block;
-			if (!block.ReadFromDisk(txindex.pos.nFile, txindex.pos.nBlockPos, false))
-				return error("GetCoinstakeAge() : Failed To Read Block from Disk");
+			/** Find the Previous Transaction's Block in the Block Index. No need to Read it from Disk. **/
+			CBlockIndex* pindex = GetBlockIndexAt(txindex.pos);
+			if (!pindex)
+				return error("GetCoinstakeAge() : Previous Transaction's Block not in Index");
 
 			/** Calculate the Age and Value of given output. **/
-			int64 nCoinAge = (nTime - block.GetBlockTime());
+			int64 nCoinAge = (nTime - pindex->GetBlockTime());
 			
 			/** Compound the Total Figures. **/
 			nAge += nCoinAge;
@@ -241,8 +232,9 @@ namespace Core
 	}
 	
 	
-	/** Obtains the proper compounded interest from given Coin Stake Transaction. **/
-	bool CTransaction::GetCoinstakeInterest(Wallet::CTxDB& txdb, int64& nInterest) const
+	/** Obtains the proper compounded interest from given Coin Stake Transaction. 
+		Input Values come from the Previous Transactions given, and their Block Times from the Block Index. **/
+	bool CTransaction::GetCoinstakeInterest(const MapPrevTx& inputs, int64& nInterest) const
 	{
 		/** Check that the transaction is Coinstake. **/
 		if(!IsCoinStake())
@@ -273,20 +265,21 @@ namespace Core
 		/** Check the coin age of each Input. **/
 		for(int nIndex = 1; nIndex < vin.size(); nIndex++)
 		{
-			CTransaction txPrev;
-			CTxIndex txindex;
-			
 			/** Ignore Outputs that are not in the Main Chain. **/
-			if (!txPrev.ReadFromDisk(txdb, vin[nIndex].prevout, txindex))
+			MapPrevTx::const_iterator mi = inputs.find(vin[nIndex].prevout.hash);
+			if (mi == inputs.end() || vin[nIndex].prevout.n >= (*mi).second.second.vout.size())
 				return error("CTransaction::GetCoinstakeInterest() : Invalid Previous Transaction");
+				
+			const CTxIndex& txindex = (*mi).second.first;
+			const CTransaction& txPrev = (*mi).second.second;
 
-			/** Read the Previous Transaction's Block from Disk. **/
-			CBlock block;
-			if (!block.ReadFromDisk(txindex.pos.nFile, txindex.pos.nBlockPos, false))
-				return error("CTransaction::GetCoinstakeInterest() : Failed To Read Block from Disk");
+			/** Find the Previous Transaction's Block in the Block Index. No need to Read it from Disk. **/
+			const CBlockIndex* pindex = GetBlockIndexAt(txindex.pos);
+			if (!pindex)
+				return error("CTransaction::GetCoinstakeInterest() : Previous Transaction's Block not in Index");
 				
 			/** Calculate the Age and Value of given output. **/
-			int64 nCoinAge = (nTime - block.GetBlockTime());
+			int64 nCoinAge = (nTime - pindex->GetBlockTime());
 			int64 nValue = txPrev.vout[vin[nIndex].prevout.n].nValue;
 			
 			/** Compound the Total Figures. **/
@@ -295,10 +288,10 @@ namespace Core
 			
 			if(fDebug)
 			{
-				printf("CTransaction::GetCoinstakeInterest() : Staking input from Block %u with age of %"PRId64", Rate %f, and value %f\n", block.nHeight, nCoinAge, nInterestRate, (double)nValue / COIN);
+				printf("CTransaction::GetCoinstakeInterest() : Staking input from Block %u with age of %" PRId64 ", Rate %f, and value %f\n", pindex->nHeight, nCoinAge, nInterestRate, (double)nValue / COIN);
 				
 				if(txPrev.IsCoinStake())
-					printf("CTransaction::GetCoinstakeInterest() : Using Previous Coin Stake Transaction for Block %u ++++++++++++++++++++++++++\n", block.nHeight);
+					printf("CTransaction::GetCoinstakeInterest() : Using Previous Coin Stake Transaction for Block %u ++++++++++++++++++++++++++\n", pindex->nHeight);
 			}
 		
 			/** Interest is 2% of Year's Interest of Value of Coins. Coin Age is in Seconds. **/
@@ -346,31 +339,38 @@ namespace Core
 		else
 			dInterestRate = 0.005;
 		
-		/** Check each Trust Key to See if we Own it if there is no Key. **/
-		for(std::map<uint576, CTrustKey>::iterator i = mapTrustKeys.begin(); i != mapTrustKeys.end() && vchTrustKey.empty(); ++i)
+		/** AddWalletKey inserts into the Index from the RPC and Key Pool Threads, so it is only read under cs. **/
+		LOCK(cs);
+		
+		/** Build the Index of Wallet Owned Trust Keys the First Time it is Needed. **/
+		if(!fWalletIndexed)
 		{
-				
-			/** Check the Wallet and Trust Keys in Trust Pool to see if we own any keys. **/
-			Wallet::NexusAddress address;
-			address.SetPubKey(i->second.vchPubKey);
-			if(pwalletMain->HaveKey(address))
+			for(std::map<uint576, CTrustKey>::iterator i = mapTrustKeys.begin(); i != mapTrustKeys.end(); ++i)
 			{
-				if(i->second.Expired(nTime))
-					continue;
-				
-				/** Extract the Key from the Script Signature. **/
-				uint576 cKey;
-				cKey.SetBytes(i->second.vchPubKey);
-					
-				/** Assigned Extracted Key to Trust Pool. **/
-				printf("CTrustPool::HasTrustKey() : New Trust Key Extracted %s\n", cKey.ToString().substr(0, 20).c_str());
-				vchTrustKey = i->second.vchPubKey;
-				
-				/** Set the Interest Rate from Key. **/
-				dInterestRate = cTrustPool.InterestRate(cKey, nTime);
-				
-				return true;
+				Wallet::NexusAddress address;
+				address.SetPubKey(i->second.vchPubKey);
+				if(pwalletMain->HaveKey(address))
+					setWalletKeys.insert(i->first);
 			}
+			
+			fWalletIndexed = true;
+		}
+		
+		/** Check the Trust Keys this Wallet Owns if there is no Key. **/
+		for(std::set<uint576>::iterator i = setWalletKeys.begin(); i != setWalletKeys.end() && vchTrustKey.empty(); ++i)
+		{
+			const CTrustKey& cTrustKey = mapTrustKeys[*i];
+			if(cTrustKey.Expired(nTime))
+				continue;
+				
+			/** Assigned Extracted Key to Trust Pool. **/
+			printf("CTrustPool::HasTrustKey() : New Trust Key Extracted %s\n", i->ToString().substr(0, 20).c_str());
+			vchTrustKey = cTrustKey.vchPubKey;
+			
+			/** Set the Interest Rate from Key. **/
+			dInterestRate = cTrustPool.InterestRate(*i, nTime);
+			
+			return true;
 		}
 		
 		//if(vchTrustKey.empty())
@@ -380,13 +380,30 @@ namespace Core
 	}
 	
 	
+	/** Keep the Wallet Key Index Current when a Wallet gains a Key that already has a Trust Key. **/
+	void CTrustPool::AddWalletKey(const Wallet::CWallet* pwallet, const std::vector<unsigned char>& vchPubKey)
+	{
+		if(pwallet != pwalletMain)
+			return;
+			
+		LOCK(cs);
+		if(!fWalletIndexed)
+			return;
+			
+		uint576 cKey;
+		cKey.SetBytes(vchPubKey);
+		if(mapTrustKeys.count(cKey))
+			setWalletKeys.insert(cKey);
+	}
+	
+	
 	/** Check a Block's Coinstake Transaction to see if it fits Trust Key Protocol. 
 	
 		If Key doesn't exist Transaction must meet Genesis Protocol Requirements.
 		If Key does exist it Must Meet Trust Protocol Requirements. 
 		
 	**/
-	bool CTrustPool::Check(CBlock cBlock)
+	bool CTrustPool::Check(const CBlock& cBlock)
 	{
 		/** Lock Accepting Trust Keys to Mutex. **/
 		LOCK(cs);
@@ -460,6 +477,10 @@ namespace Core
 				return error("CTrustPool::check() : Trust Block Input Hash Mismatch to Trust Key Hash\n%s\n%s", cBlock.vtx[0].vin[0].prevout.hash.ToString().c_str(), mapTrustKeys[cKey].GetHash().ToString().c_str());
 			}
 			
+			/** Genesis Coinstake Facts are Cached once Verified, Only go to Disk the First Time. **/
+			if(mapTrustKeys[cKey].fGenesisVerified)
+				return true;
+			
 			/** Read the Genesis Transaction's Block from Disk. **/
 			CBlock cBlockGenesis;
 			if(!cBlockGenesis.ReadFromDisk(mapBlockIndex[mapTrustKeys[cKey].hashGenesisBlock]->nFile, mapBlockIndex[mapTrustKeys[cKey].hashGenesisBlock]->nBlockPos, true))
@@ -468,6 +489,8 @@ namespace Core
 			/** Double Check the Genesis Transaction. **/
 			if(!mapTrustKeys[cKey].CheckGenesis(cBlockGenesis))
 				return error("CTrustPool::check() : Invalid Genesis Transaction.");
+				
+			mapTrustKeys[cKey].fGenesisVerified = true;
 			
 			return true;
 		}
@@ -477,7 +500,7 @@ namespace Core
 		
 		
 	/** Remove a Block from Trust Key. **/
-	bool CTrustPool::Remove(CBlock cBlock)
+	bool CTrustPool::Remove(const CBlock& cBlock)
 	{
 		/** Lock Accepting Trust Keys to Mutex. **/
 		LOCK(cs);
@@ -505,6 +528,7 @@ namespace Core
 				
 			/** Remove the Trust Key from the Trust Pool. **/
 			mapTrustKeys.erase(cKey);
+			setWalletKeys.erase(cKey);
 			printf("CTrustPool::Remove() : Removed Genesis Trust Key %s From Trust Pool\n", cKey.ToString().substr(0, 20).c_str());
 				
 			return true;
@@ -535,7 +559,7 @@ namespace Core
 	
 	/** Accept a Block's Coinstake into the Trust Pool Assigning it to Specified Trust Key.  
 		This Method shouldn't be called before CTrustPool::Check **/
-	bool CTrustPool::Accept(CBlock cBlock, bool fInit)
+	bool CTrustPool::Accept(const CBlock& cBlock, bool fInit)
 	{
 		/** Lock Accepting Trust Keys to Mutex. **/
 		LOCK(cs);
@@ -557,10 +581,21 @@ namespace Core
 		/** Handle Genesis Transaction Rules. Genesis is checked after Trust Key Established. **/
 		if(cBlock.vtx[0].IsGenesis())
 		{
-			/** Add the New Trust Key to the Trust Pool Memory Map. **/
+			/** Add the New Trust Key to the Trust Pool Memory Map. 
+				Its Genesis Facts come from this Block itself, which Check has already verified. **/
 			CTrustKey cTrustKey(vKeys[0], cBlock.GetHash(), cBlock.vtx[0].GetHash(), cBlock.nTime);
+			cTrustKey.fGenesisVerified = true;
 			mapTrustKeys[cKey] = cTrustKey;
 			
+			/** Index the Key if the Main Wallet Owns it. **/
+			if(fWalletIndexed && pwalletMain)
+			{
+				Wallet::NexusAddress address;
+				address.SetPubKey(vKeys[0]);
+				if(pwalletMain->HaveKey(address))
+					setWalletKeys.insert(cKey);
+			}
+			
 			/** Dump the Trust Key To Console if not Initializing. **/
 			if(!fInit)
 				cTrustKey.Print();
@@ -610,7 +645,7 @@ namespace Core
 	
 	/** Should not be called until key is established in block chain. 
 		Block must have been received and be part of the main chain. **/
-	bool CTrustKey::CheckGenesis(CBlock cBlock) const
+	bool CTrustKey::CheckGenesis(const CBlock& cBlock) const
 	{
 		/** Invalid if Null. **/
 		if(IsNull())
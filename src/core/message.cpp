@@ -14,6 +14,7 @@
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
+#include <boost/thread.hpp>
 
 using namespace std;
 using namespace boost;
@@ -83,7 +84,7 @@ namespace Core
 
 		case Net::MSG_BLOCK:
 			return mapBlockIndex.count(inv.hash) ||
-				   mapOrphanBlocks.count(inv.hash);
+				   cOrphanBlocks.Has(inv.hash);
 		}
 		// Don't know what it is, just say we already got one
 		return true;
@@ -92,8 +93,191 @@ namespace Core
 
 
 
-	bool ProcessMessage(Net::CNode* pfrom, string strCommand, CDataStream& vRecv)
+	/** Framed block Messages of the most recently requested Blocks. A new Block is requested by most
+		Peers at once, so it is read from disk, serialized and checksummed once instead of once per Peer. **/
+	struct CRecentBlock
 	{
+		uint1024 hash;
+		int nVersion;
+		Net::CSendBuffer pmsg;
+	};
+	static std::list<CRecentBlock> lRecentBlocks;
+	static const unsigned int MAX_RECENT_BLOCKS = 8;
+	
+	
+	/** Get the block Message for pindex, most recently used first. Requires cs_main. **/
+	static Net::CSendBuffer GetBlockMessage(CBlockIndex* pindex, int nVersion)
+	{
+		uint1024 hash = pindex->GetBlockHash();
+		for (std::list<CRecentBlock>::iterator it = lRecentBlocks.begin(); it != lRecentBlocks.end(); ++it)
+		{
+			if (it->hash == hash && it->nVersion == nVersion)
+			{
+				lRecentBlocks.splice(lRecentBlocks.begin(), lRecentBlocks, it);
+				return lRecentBlocks.front().pmsg;
+			}
+		}
+		
+		CBlock block;
+		if (!block.ReadFromDisk(pindex))
+			return Net::CSendBuffer();
+			
+		CRecentBlock recent;
+		recent.hash     = hash;
+		recent.nVersion = nVersion;
+		recent.pmsg     = Net::MakeMessage("block", block, nVersion);
+		
+		lRecentBlocks.push_front(recent);
+		if (lRecentBlocks.size() > MAX_RECENT_BLOCKS)
+			lRecentBlocks.pop_back();
+			
+		return recent.pmsg;
+	}
+	
+	
+	/** Compact Block waiting on the Transactions its Peer still has to send. Guarded by cs_main. **/
+	struct CPartialBlock
+	{
+		CBlock block;
+		std::vector<bool> vHave;
+		std::string strPeer;
+		int64 nTime;
+	};
+	static std::map<uint1024, CPartialBlock> mapPartialBlocks;
+	static const unsigned int MAX_PARTIAL_BLOCKS = 16;
+	static const unsigned int MAX_PARTIAL_BLOCKS_PER_PEER = 2;
+	
+	/** Below the size of any valid Transaction: its one Input's Outpoint alone is 68 Bytes. Bounds the
+		Transaction count a Compact Block can claim, since a Block of MAX_BLOCK_SIZE Bytes holds no more. **/
+	static const unsigned int MIN_TRANSACTION_SIZE = 64;
+	
+	
+	/** Check the Proof of a Compact Block Header before any work is done to rebuild it. The Proof of Stake
+		is checked against the Prefilled Coinstake, the rest of the Block is checked again once it is whole. Requires cs_main. **/
+	static bool CheckCompactHeader(const CCompactBlock& cmpct, const CBlockIndex* pindexPrev)
+	{
+		const CBlock& header = cmpct.header;
+		if (!header.IsProofOfWork() && !header.IsProofOfStake())
+			return error("CheckCompactHeader() : unknown channel %u", header.nChannel);
+			
+		if (header.nHeight != pindexPrev->nHeight + 1)
+			return error("CheckCompactHeader() : incorrect height %u", header.nHeight);
+			
+		if (header.nBits != GetNextTargetRequired(pindexPrev, header.GetChannel(), false))
+			return error("CheckCompactHeader() : incorrect proof of work/stake target");
+			
+		if (header.IsProofOfWork())
+			return header.VerifyWork();
+			
+		if (cmpct.vPrefilled.empty() || cmpct.vPrefilled[0].first != 0)
+			return error("CheckCompactHeader() : coinstake not prefilled");
+			
+		CBlock block = header;
+		block.vtx.push_back(cmpct.vPrefilled[0].second);
+		if (!block.CheckBlockSignature())
+			return error("CheckCompactHeader() : bad block signature");
+			
+		return block.VerifyStake();
+	}
+	
+	
+	/** Fill a Block from a Compact Block and the Memory Pool, listing the Block Indexes still missing.
+		Returns false if the Compact Block is malformed or its own Short IDs collide. **/
+	static bool InitPartialBlock(const CCompactBlock& cmpct, CPartialBlock& partial, std::vector<unsigned int>& vMissing)
+	{
+		unsigned int nSize = cmpct.Size();
+		if (nSize == 0 || nSize > MAX_BLOCK_SIZE / MIN_TRANSACTION_SIZE)
+			return false;
+			
+		CBlock& block = partial.block;
+		block = cmpct.header;
+		block.vtx.resize(nSize);
+		partial.vHave.assign(nSize, false);
+		
+		for (unsigned int i = 0; i < cmpct.vPrefilled.size(); i++)
+		{
+			unsigned int nIndex = cmpct.vPrefilled[i].first;
+			if (nIndex >= nSize || partial.vHave[nIndex])
+				return false;
+				
+			block.vtx[nIndex] = cmpct.vPrefilled[i].second;
+			partial.vHave[nIndex] = true;
+		}
+		
+		/** Short IDs take the Slots left after Prefilling, in order. **/
+		map<uint64, unsigned int> mapSlots;
+		unsigned int nSlot = 0;
+		BOOST_FOREACH(uint64 nShortID, cmpct.vShortIDs)
+		{
+			while (partial.vHave[nSlot])
+				nSlot++;
+				
+			if (!mapSlots.insert(make_pair(nShortID, nSlot++)).second)
+				return false;
+		}
+		
+		{
+			LOCK(mempool.cs);
+			set<unsigned int> setCollided;
+			for (map<uint512, CTransaction>::iterator mi = mempool.mapTx.begin(); mi != mempool.mapTx.end(); ++mi)
+			{
+				map<uint64, unsigned int>::iterator it = mapSlots.find(cmpct.GetShortID(mi->first));
+				if (it == mapSlots.end() || setCollided.count(it->second))
+					continue;
+					
+				/** Two Pool Transactions share the Short ID. Neither can be trusted, so the Peer sends it. **/
+				if (partial.vHave[it->second])
+				{
+					block.vtx[it->second] = CTransaction();
+					partial.vHave[it->second] = false;
+					setCollided.insert(it->second);
+					
+					continue;
+				}
+				
+				block.vtx[it->second] = mi->second;
+				partial.vHave[it->second] = true;
+			}
+		}
+		
+		for (unsigned int i = 0; i < nSize; i++)
+			if (!partial.vHave[i])
+				vMissing.push_back(i);
+				
+		return true;
+	}
+	
+	
+	static void RequestFullBlock(Net::CNode* pfrom, const uint1024& hash)
+	{
+		vector<Net::CInv> vGetData(1, Net::CInv(Net::MSG_BLOCK, hash));
+		pfrom->PushMessage("getdata", vGetData);
+	}
+	
+	
+	/** Hand a reconstructed Block to ProcessBlock once its Transactions match the Merkle Root, otherwise fetch it whole. **/
+	static void FinishPartialBlock(Net::CNode* pfrom, CBlock& block)
+	{
+		uint1024 hash = block.GetHash();
+		if (block.BuildMerkleTree() != block.hashMerkleRoot)
+		{
+			printf("compact block %s : merkle root mismatch, requesting full block\n", hash.ToString().substr(0,20).c_str());
+			RequestFullBlock(pfrom, hash);
+			
+			return;
+		}
+		
+		if (ProcessBlock(pfrom, &block))
+			Net::mapAlreadyAskedFor.erase(Net::CInv(Net::MSG_BLOCK, hash));
+		if (block.nDoS) pfrom->Misbehaving(block.nDoS);
+	}
+	
+	
+	bool ProcessMessage(Net::CNode* pfrom, Net::CNetMessage& msg)
+	{
+		string strCommand = msg.hdr.GetCommand();
+		CDataStream& vRecv = msg.vRecv;
+		
 		static map<Net::CService, vector<unsigned char> > mapReuseKey;
 		RandAddSeedPerfmon();
 		if (fDebug) {
@@ -216,7 +400,20 @@ namespace Core
 
 		else if (strCommand == "verack")
 		{
-			pfrom->vRecv.SetVersion(min(pfrom->nVersion, PROTOCOL_VERSION));
+			pfrom->nRecvVersion = min(pfrom->nVersion, PROTOCOL_VERSION);
+			
+			/** Ask for new Blocks as Compact Blocks. Peers that do not know the Message ignore it. **/
+			pfrom->PushMessage("sendcmpct", true, (uint64)1);
+		}
+
+
+		else if (strCommand == "sendcmpct")
+		{
+			bool fAnnounce = false;
+			uint64 nCompactVersion = 0;
+			vRecv >> fAnnounce >> nCompactVersion;
+			
+			pfrom->fPreferCompact = (fAnnounce && nCompactVersion == 1);
 		}
 
 
@@ -314,8 +511,8 @@ namespace Core
 
 				if (!fAlreadyHave)
 					pfrom->AskFor(inv);
-				else if (inv.type == Net::MSG_BLOCK && mapOrphanBlocks.count(inv.hash)) {
-					pfrom->PushGetBlocks(pindexBest, GetOrphanRoot(mapOrphanBlocks[inv.hash]));
+				else if (inv.type == Net::MSG_BLOCK && cOrphanBlocks.Has(inv.hash)) {
+					pfrom->PushGetBlocks(pindexBest, cOrphanBlocks.GetRoot(inv.hash));
 				} else if (nInv == nLastBlock) {
 					// In case we are on a very long side-chain, it is possible that we already have
 					// the last block in an inv bundle sent in response to getblocks. Try to detect
@@ -354,11 +551,11 @@ namespace Core
 					map<uint1024, CBlockIndex*>::iterator mi = mapBlockIndex.find(inv.hash);
 					if (mi != mapBlockIndex.end())
 					{
-						CBlock block;
-						if(!block.ReadFromDisk((*mi).second))
+						Net::CSendBuffer pmsg = GetBlockMessage((*mi).second, pfrom->vSend.nVersion);
+						if(!pmsg)
 							return error("ProcessMessage() : Could not read Block.");
 						
-						pfrom->PushMessage("block", block);
+						pfrom->PushBuffer(pmsg);
 
 						// Trigger them to send a getblocks request for the next batch of inventory
 						if (inv.hash == pfrom->hashContinue)
@@ -378,13 +575,10 @@ namespace Core
 				}
 				else if (inv.IsKnownType())
 				{
-					// Send stream from relay memory
-					{
-						LOCK(Net::cs_mapRelay);
-						map<Net::CInv, CDataStream>::iterator mi = Net::mapRelay.find(inv);
-						if (mi != Net::mapRelay.end())
-							pfrom->PushMessage(inv.GetCommand(), (*mi).second);
-					}
+					// Send the shared message from relay memory
+					Net::CSendBuffer pmsg = Net::cRelayCache.Get(inv);
+					if (pmsg)
+						pfrom->PushBuffer(pmsg);
 				}
 
 				// Track requests for our stuff
@@ -478,10 +672,20 @@ namespace Core
 			CDataStream vMsg(vRecv);
 			Wallet::CTxDB txdb("r");
 			CTransaction tx;
-			vRecv >> tx;
+			if (msg.ptx)
+				tx = *msg.ptx;
+			else
+				vRecv >> tx;
 
 			Net::CInv inv(Net::MSG_TX, tx.GetHash());
 			pfrom->AddInventoryKnown(inv);
+			
+			/** Rejected by CheckTransaction on the Message Worker. **/
+			if (msg.fChecked && !msg.fValid)
+			{
+				if (tx.nDoS) pfrom->Misbehaving(tx.nDoS);
+				return error("message tx : CheckTransaction failed");
+			}
 
 			bool fMissingInputs = false;
 			if (tx.AcceptToMemoryPool(txdb, true, &fMissingInputs))
@@ -542,8 +746,10 @@ namespace Core
 
 		else if (strCommand == "block")
 		{
-			CBlock block;
-			vRecv >> block;
+			CBlock tmpblock;
+			CBlock& block = msg.pblock ? *msg.pblock : tmpblock;
+			if (!msg.pblock)
+				vRecv >> block;
 
 			printf("received block %s\n", block.GetHash().ToString().substr(0,20).c_str());
 			
@@ -552,13 +758,171 @@ namespace Core
 
 			Net::CInv inv(Net::MSG_BLOCK, block.GetHash());
 			pfrom->AddInventoryKnown(inv);
+			mapPartialBlocks.erase(inv.hash);
 
-			if (ProcessBlock(pfrom, &block))
+			/** The Message Worker already ran the context free part of CheckBlock. **/
+			if (msg.fChecked && !msg.fValid)
+				error("ProcessBlock() : CheckBlock FAILED");
+			else if (ProcessBlock(pfrom, &block, msg.fChecked))
 				Net::mapAlreadyAskedFor.erase(inv);
 			if (block.nDoS) pfrom->Misbehaving(block.nDoS);
 		}
 
 
+		else if (strCommand == "cmpctblock")
+		{
+			CCompactBlock cmpct;
+			vRecv >> cmpct;
+			
+			uint1024 hash = cmpct.header.GetHash();
+			Net::CInv inv(Net::MSG_BLOCK, hash);
+			pfrom->AddInventoryKnown(inv);
+			
+			printf("received compact block %s (%u transactions, %u prefilled)\n", hash.ToString().substr(0,20).c_str(), cmpct.Size(), cmpct.vPrefilled.size());
+			
+			Wallet::CTxDB txdb("r");
+			if (AlreadyHave(txdb, inv) || mapPartialBlocks.count(hash))
+				return true;
+				
+			/** Without its previous Block this would only be an Orphan, which the Orphan Pool takes whole. **/
+			map<uint1024, CBlockIndex*>::iterator miPrev = mapBlockIndex.find(cmpct.header.hashPrevBlock);
+			if (miPrev == mapBlockIndex.end())
+			{
+				RequestFullBlock(pfrom, hash);
+				return true;
+			}
+			
+			/** A forged Header would cost a Memory Pool scan and a Slot of a genuine Block. **/
+			if (!CheckCompactHeader(cmpct, miPrev->second))
+			{
+				pfrom->Misbehaving(50);
+				return error("message cmpctblock : invalid header %s", hash.ToString().substr(0,20).c_str());
+			}
+			
+			/** Make room, from this Peer's own Partial Blocks first so one Peer cannot push out the others. **/
+			unsigned int nPeerPartial = 0;
+			map<uint1024, CPartialBlock>::iterator oldest = mapPartialBlocks.end(), oldestPeer = mapPartialBlocks.end();
+			for (map<uint1024, CPartialBlock>::iterator mi = mapPartialBlocks.begin(); mi != mapPartialBlocks.end(); ++mi)
+			{
+				if (oldest == mapPartialBlocks.end() || mi->second.nTime < oldest->second.nTime)
+					oldest = mi;
+					
+				if (mi->second.strPeer != pfrom->addrName)
+					continue;
+					
+				nPeerPartial++;
+				if (oldestPeer == mapPartialBlocks.end() || mi->second.nTime < oldestPeer->second.nTime)
+					oldestPeer = mi;
+			}
+			
+			if (nPeerPartial >= MAX_PARTIAL_BLOCKS_PER_PEER)
+				mapPartialBlocks.erase(oldestPeer);
+			else if (mapPartialBlocks.size() >= MAX_PARTIAL_BLOCKS)
+				mapPartialBlocks.erase(oldest);
+			
+			CPartialBlock& partial = mapPartialBlocks[hash];
+			partial.strPeer = pfrom->addrName;
+			partial.nTime   = GetUnifiedTimestamp();
+			
+			vector<unsigned int> vMissing;
+			if (!InitPartialBlock(cmpct, partial, vMissing))
+			{
+				mapPartialBlocks.erase(hash);
+				RequestFullBlock(pfrom, hash);
+				
+				return true;
+			}
+			
+			if (vMissing.empty())
+			{
+				CBlock block = partial.block;
+				mapPartialBlocks.erase(hash);
+				FinishPartialBlock(pfrom, block);
+				
+				return true;
+			}
+			
+			if (fDebug)
+				printf("compact block %s : requesting %u of %u transactions\n", hash.ToString().substr(0,20).c_str(), vMissing.size(), cmpct.Size());
+				
+			CBlockTxRequest req;
+			req.hashBlock = hash;
+			req.vIndexes  = vMissing;
+			pfrom->PushMessage("getblocktxn", req);
+		}
+
+
+		else if (strCommand == "getblocktxn")
+		{
+			CBlockTxRequest req;
+			vRecv >> req;
+			
+			map<uint1024, CBlockIndex*>::iterator mi = mapBlockIndex.find(req.hashBlock);
+			if (mi == mapBlockIndex.end())
+				return true;
+				
+			CBlock block;
+			if (!block.ReadFromDisk((*mi).second))
+				return error("ProcessMessage() : Could not read Block.");
+				
+			CBlockTxResponse resp;
+			resp.hashBlock = req.hashBlock;
+			BOOST_FOREACH(unsigned int nIndex, req.vIndexes)
+			{
+				if (nIndex >= block.vtx.size())
+				{
+					pfrom->Misbehaving(100);
+					return error("message getblocktxn index %u out of range", nIndex);
+				}
+				
+				resp.vtx.push_back(block.vtx[nIndex]);
+			}
+			
+			pfrom->PushMessage("blocktxn", resp);
+		}
+
+
+		else if (strCommand == "blocktxn")
+		{
+			CBlockTxResponse resp;
+			vRecv >> resp;
+			
+			map<uint1024, CPartialBlock>::iterator mi = mapPartialBlocks.find(resp.hashBlock);
+			if (mi == mapPartialBlocks.end() || mi->second.strPeer != pfrom->addrName)
+				return true;
+				
+			CPartialBlock& partial = mi->second;
+			unsigned int nNext = 0;
+			bool fComplete = true;
+			for (unsigned int i = 0; i < partial.vHave.size(); i++)
+			{
+				if (partial.vHave[i])
+					continue;
+					
+				if (nNext >= resp.vtx.size())
+				{
+					fComplete = false;
+					break;
+				}
+				
+				partial.block.vtx[i] = resp.vtx[nNext++];
+			}
+			
+			CBlock block = partial.block;
+			mapPartialBlocks.erase(mi);
+			
+			if (!fComplete || nNext != resp.vtx.size())
+			{
+				pfrom->Misbehaving(10);
+				RequestFullBlock(pfrom, resp.hashBlock);
+				
+				return error("message blocktxn : wrong transaction count for %s", resp.hashBlock.ToString().substr(0,20).c_str());
+			}
+			
+			FinishPartialBlock(pfrom, block);
+		}
+
+
 		else if (strCommand == "getaddr")
 		{
 			pfrom->vAddrToSend.clear();
@@ -602,14 +966,88 @@ namespace Core
 		return true;
 	}
 
+	/** Messages waiting for a Message Worker. Shared by all Peers, each Peer keeps its own Dispatch order. **/
+	static std::deque< boost::shared_ptr<Net::CNetMessage> > vWorkerQueue;
+	static boost::mutex WORKER_MUTEX;
+	static boost::condition_variable WORKER_CONDITION;
+	
+	
+	/** Checksum, Deserialization and context free Checks of a Message. Runs on a Message Worker without cs_main. **/
+	static void PrepareMessage(Net::CNetMessage& msg)
+	{
+		uint512 hash = SK512(msg.vRecv.begin(), msg.vRecv.end());
+		unsigned int nChecksum = 0;
+		memcpy(&nChecksum, &hash, sizeof(nChecksum));
+		
+		msg.fChecksum = (nChecksum == msg.hdr.nChecksum);
+		if (!msg.fChecksum)
+			return;
+			
+		string strCommand = msg.hdr.GetCommand();
+		try
+		{
+			if (strCommand == "block")
+			{
+				boost::shared_ptr<CBlock> pblock(new CBlock());
+				msg.vRecv >> *pblock;
+				
+				msg.fValid   = pblock->CheckBlock(false);
+				msg.fChecked = true;
+				msg.pblock   = pblock;
+			}
+			else if (strCommand == "tx")
+			{
+				/** The Raw Transaction is kept for Relay, so Deserialize from a Copy. **/
+				boost::shared_ptr<CTransaction> ptx(new CTransaction());
+				CDataStream(msg.vRecv) >> *ptx;
+				
+				msg.fValid   = ptx->CheckTransaction();
+				msg.fChecked = true;
+				msg.ptx      = ptx;
+			}
+		}
+		catch (std::exception& e)
+		{
+			msg.strError = e.what();
+		}
+	}
+	
+	
+	/** Message Worker Thread. Any Worker may Prepare any Peer's Message. **/
+	void ThreadMessageWorker(void* parg)
+	{
+		vnThreadsRunning[THREAD_MESSAGEWORKER]++;
+		while (!fShutdown)
+		{
+			boost::shared_ptr<Net::CNetMessage> pmsg;
+			{
+				boost::unique_lock<boost::mutex> lock(WORKER_MUTEX);
+				while (vWorkerQueue.empty() && !fShutdown)
+					WORKER_CONDITION.timed_wait(lock, boost::posix_time::milliseconds(1000));
+					
+				if (fShutdown)
+					break;
+					
+				pmsg = vWorkerQueue.front();
+				vWorkerQueue.pop_front();
+			}
+			
+			PrepareMessage(*pmsg);
+			pmsg->fReady = true;
+		}
+		vnThreadsRunning[THREAD_MESSAGEWORKER]--;
+	}
+	
+	
+	/** Messages that never read or write Chain State are Processed without cs_main. **/
+	static bool RequiresChainState(const string& strCommand)
+	{
+		return !(strCommand == "verack" || strCommand == "sendcmpct" || strCommand == "addr" || strCommand == "getaddr" || strCommand == "ping");
+	}
+	
+	
 	bool ProcessMessages(Net::CNode* pfrom)
 	{
-		CDataStream& vRecv = pfrom->vRecv;
-		if (vRecv.empty())
-			return true;
-		//if (fDebug)
-		//    printf("ProcessMessages(%u bytes)\n", vRecv.size());
-
 		//
 		// Message format
 		//  (4) message start
@@ -630,72 +1068,64 @@ namespace Core
 			nTimeLastPrintMessageStart = GetUnifiedTimestamp();
 		}
 
-		loop
+		// Hand the messages the socket handler has finished receiving to the message workers. Stop while
+		// this peer already has a receive buffer worth in flight, so the socket flood control still applies
+		while (!pfrom->vRecvMsg.empty() && pfrom->vRecvMsg.front()->Complete() && pfrom->nProcessMsgSize < Net::ReceiveBufferSize())
 		{
-			// Scan for message start
-			CDataStream::iterator pstart = search(vRecv.begin(), vRecv.end(), BEGIN(pchMessageStart), END(pchMessageStart));
-			int nHeaderSize = vRecv.GetSerializeSize(Net::CMessageHeader());
-			if (vRecv.end() - pstart < nHeaderSize)
-			{
-				if ((int)vRecv.size() > nHeaderSize)
-				{
-					printf("\n\nPROCESSMESSAGE MESSAGESTART NOT FOUND\n\n");
-					vRecv.erase(vRecv.begin(), vRecv.end() - nHeaderSize);
-				}
-				break;
-			}
-			if (pstart - vRecv.begin() > 0)
-				printf("\n\nPROCESSMESSAGE SKIPPED %d BYTES\n\n", pstart - vRecv.begin());
-			vRecv.erase(vRecv.begin(), pstart);
-
-			// Read header
-			vector<char> vHeaderSave(vRecv.begin(), vRecv.begin() + nHeaderSize);
-			Net::CMessageHeader hdr;
-			vRecv >> hdr;
-			if (!hdr.IsValid())
+			boost::shared_ptr<Net::CNetMessage> pmsg = pfrom->vRecvMsg.front();
+			pfrom->vRecvMsg.pop_front();
+			pfrom->nRecvSize -= pmsg->hdr.nMessageSize;
+			
+			pfrom->vProcessMsg.push_back(pmsg);
+			pfrom->nProcessMsgSize += pmsg->hdr.nMessageSize;
 			{
-				printf("\n\nPROCESSMESSAGE: ERRORS IN HEADER %s\n\n\n", hdr.GetCommand().c_str());
-				continue;
+				boost::lock_guard<boost::mutex> lock(WORKER_MUTEX);
+				vWorkerQueue.push_back(pmsg);
 			}
-			string strCommand = hdr.GetCommand();
+			WORKER_CONDITION.notify_one();
+		}
 
-			// Message size
-			unsigned int nMessageSize = hdr.nMessageSize;
-			if (nMessageSize > MAX_SIZE)
+		// Dispatch the messages the workers are done with, in the order they were received
+		while (!pfrom->vProcessMsg.empty() && pfrom->vProcessMsg.front()->fReady)
+		{
+			boost::shared_ptr<Net::CNetMessage> pmsg = pfrom->vProcessMsg.front();
+			pfrom->vProcessMsg.pop_front();
+			
+			string strCommand = pmsg->hdr.GetCommand();
+			unsigned int nMessageSize = pmsg->hdr.nMessageSize;
+			pfrom->nProcessMsgSize -= nMessageSize;
+			
+			// Checksum
+			if (!pmsg->fChecksum)
 			{
-				printf("ProcessMessages(%s, %u bytes) : nMessageSize > MAX_SIZE\n", strCommand.c_str(), nMessageSize);
+				printf("ProcessMessages(%s, %u bytes) : CHECKSUM ERROR hdr.nChecksum=%08x\n",
+				   strCommand.c_str(), nMessageSize, pmsg->hdr.nChecksum);
 				continue;
 			}
-			if (nMessageSize > vRecv.size())
-			{
-				// Rewind and wait for rest of message
-				vRecv.insert(vRecv.begin(), vHeaderSave.begin(), vHeaderSave.end());
-				break;
-			}
-
-			// Checksum
-			uint512 hash = SK512(vRecv.begin(), vRecv.begin() + nMessageSize);
-			unsigned int nChecksum = 0;
-			memcpy(&nChecksum, &hash, sizeof(nChecksum));
-			if (nChecksum != hdr.nChecksum)
+			
+			// Deserialization failed on the worker
+			if (!pmsg->strError.empty())
 			{
-				printf("ProcessMessages(%s, %u bytes) : CHECKSUM ERROR nChecksum=%08x hdr.nChecksum=%08x\n",
-				   strCommand.c_str(), nMessageSize, nChecksum, hdr.nChecksum);
+				printf("ProcessMessages(%s, %u bytes) : Exception '%s' caught\n", strCommand.c_str(), nMessageSize, pmsg->strError.c_str());
+				printf("ProcessMessage(%s, %u bytes) FAILED\n", strCommand.c_str(), nMessageSize);
 				continue;
 			}
 
-			// Copy message to its own buffer
-			CDataStream vMsg(vRecv.begin(), vRecv.begin() + nMessageSize, vRecv.nType, vRecv.nVersion);
-			vRecv.ignore(nMessageSize);
+			// Framed ahead of dispatch, so pick up a version change from an earlier verack
+			pmsg->vRecv.SetVersion(pfrom->nRecvVersion);
 
 			// Process message
 			bool fRet = false;
 			try
 			{
+				if (RequiresChainState(strCommand))
 				{
 					LOCK(cs_main);
-					fRet = ProcessMessage(pfrom, strCommand, vMsg);
+					fRet = ProcessMessage(pfrom, *pmsg);
 				}
+				else
+					fRet = ProcessMessage(pfrom, *pmsg);
+					
 				if (fShutdown)
 					return true;
 			}
@@ -726,12 +1156,43 @@ namespace Core
 				printf("ProcessMessage(%s, %u bytes) FAILED\n", strCommand.c_str(), nMessageSize);
 		}
 
-		vRecv.Compact();
 		return true;
 	}
 
 
-	bool SendMessages(Net::CNode* pto, bool fSendTrickle)
+	/** Average time between trickled Transaction inv Messages to an inbound Peer. Outbound Peers get
+		half of it, since those are the connections we picked and they are harder for a spy to occupy. **/
+	static const int64 INVENTORY_BROADCAST_INTERVAL = 5000;
+	
+	/** Average time between addr Messages to a Peer. **/
+	static const int64 AVG_ADDRESS_BROADCAST_INTERVAL = 30000;
+	
+	
+	/** Next send time in milliseconds for a Poisson process with the given average interval. Every Peer
+		draws its own delays, so the order in which Peers hear of a Transaction says little about its origin. **/
+	static int64 PoissonNextSend(int64 nNow, int64 nAverageInterval)
+	{
+		return nNow + (int64)(log1p(GetRand(1ULL << 48) * -0.0000000000000035527136788 /* -1/2^48 */) * nAverageInterval * -1.0 + 0.5);
+	}
+	
+	
+	/** Queue an inv for a Peer unless its filter says it already has it. Caller holds pto->cs_inventory. **/
+	static void AddInventoryToSend(Net::CNode* pto, vector<Net::CInv>& vInv, const Net::CInv& inv)
+	{
+		if (pto->filterInventoryKnown.contains(BEGIN(inv.hash), END(inv.hash)))
+			return;
+			
+		pto->filterInventoryKnown.insert(BEGIN(inv.hash), END(inv.hash));
+		vInv.push_back(inv);
+		if (vInv.size() >= 1000)
+		{
+			pto->PushMessage("inv", vInv);
+			vInv.clear();
+		}
+	}
+	
+	
+	bool SendMessages(Net::CNode* pto)
 	{
 		TRY_LOCK(cs_main, lockMain);
 		if (lockMain) {
@@ -741,7 +1202,7 @@ namespace Core
 
 			// Keep-alive ping. We send a nonce of zero because we don't use it anywhere
 			// right now.
-			if (pto->nLastSend && GetUnifiedTimestamp() - pto->nLastSend > 30 * 60 && pto->vSend.empty()) {
+			if (pto->nLastSend && GetUnifiedTimestamp() - pto->nLastSend > 30 * 60 && pto->vSendMsg.empty()) {
 				uint64 nonce = 0;
 				pto->PushMessage("ping", nonce);
 			}
@@ -773,11 +1234,15 @@ namespace Core
 				nLastRebroadcast = GetUnifiedTimestamp();
 			}
 
+			int64 nNowMillis = GetTimeMillis();
+			
 			//
 			// Message: addr
 			//
-			if (fSendTrickle)
+			if (pto->nNextAddrSend < nNowMillis)
 			{
+				pto->nNextAddrSend = PoissonNextSend(nNowMillis, AVG_ADDRESS_BROADCAST_INTERVAL);
+				
 				vector<Net::CAddress> vAddr;
 				vAddr.reserve(pto->vAddrToSend.size());
 				BOOST_FOREACH(const Net::CAddress& addr, pto->vAddrToSend)
@@ -804,55 +1269,24 @@ namespace Core
 			// Message: inventory
 			//
 			vector<Net::CInv> vInv;
-			vector<Net::CInv> vInvWait;
 			{
 				LOCK(pto->cs_inventory);
-				vInv.reserve(pto->vInventoryToSend.size());
-				vInvWait.reserve(pto->vInventoryToSend.size());
-				BOOST_FOREACH(const Net::CInv& inv, pto->vInventoryToSend)
+				
+				/** Blocks are not trickled, every pass flushes them. **/
+				BOOST_FOREACH(const Net::CInv& inv, pto->vBlockInventoryToSend)
+					AddInventoryToSend(pto, vInv, inv);
+				pto->vBlockInventoryToSend.clear();
+				
+				/** Everything else goes out as one batch when this Peer's timer fires. **/
+				if (pto->nNextInvSend < nNowMillis)
 				{
-					if (pto->setInventoryKnown.count(inv))
-						continue;
-
-					// trickle out tx inv to protect privacy
-					if (inv.type == Net::MSG_TX && !fSendTrickle)
-					{
-						// 1/4 of tx invs blast to all immediately
-						static uint512 hashSalt;
-						if (hashSalt == 0)
-							hashSalt = GetRand512();
-						uint512 hashRand = inv.hash.getuint512() ^ hashSalt;
-						hashRand = SK512(BEGIN(hashRand), END(hashRand));
-						bool fTrickleWait = ((hashRand & 3) != 0);
-
-						// always trickle our own transactions
-						if (!fTrickleWait)
-						{
-							Wallet::CWalletTx wtx;
-							if (GetTransaction(inv.hash.getuint512(), wtx))
-								if (wtx.fFromMe)
-									fTrickleWait = true;
-						}
-
-						if (fTrickleWait)
-						{
-							vInvWait.push_back(inv);
-							continue;
-						}
-					}
-
-					// returns true if wasn't already contained in the set
-					if (pto->setInventoryKnown.insert(inv).second)
-					{
-						vInv.push_back(inv);
-						if (vInv.size() >= 1000)
-						{
-							pto->PushMessage("inv", vInv);
-							vInv.clear();
-						}
-					}
+					pto->nNextInvSend = PoissonNextSend(nNowMillis, pto->fInbound ? INVENTORY_BROADCAST_INTERVAL : INVENTORY_BROADCAST_INTERVAL / 2);
+					
+					vInv.reserve(vInv.size() + pto->vInventoryToSend.size());
+					BOOST_FOREACH(const Net::CInv& inv, pto->vInventoryToSend)
+						AddInventoryToSend(pto, vInv, inv);
+					pto->vInventoryToSend.clear();
 				}
-				pto->vInventoryToSend = vInvWait;
 			}
 			if (!vInv.empty())
 				pto->PushMessage("inv", vInv);
@@ -886,6 +1320,59 @@ namespace Core
 		}
 		return true;
 	}
+	
+	
+	/** CPU Time per Transaction relayed to nPeers inbound Peers, driven through PushInventory and SendMessages the way the
+		Message Handler drives them. Each Peer has already announced a quarter of the Transactions to us. Run with -bench=relay. **/
+	void BenchRelay(unsigned int nPeers, unsigned int nTransactions)
+	{
+		vector<Net::CNode*> vPeers;
+		for (unsigned int i = 0; i < nPeers; i++)
+		{
+			Net::CNode* pnode = new Net::CNode(INVALID_SOCKET, Net::CAddress(), true);
+			pnode->nVersion = PROTOCOL_VERSION;
+			vPeers.push_back(pnode);
+		}
+		
+		vector<uint512> vHashes(nTransactions);
+		BOOST_FOREACH(uint512& hash, vHashes)
+			hash = GetRand512();
+			
+		clock_t nStart = clock();
+		for (unsigned int i = 0; i < nTransactions; i++)
+		{
+			Net::CInv inv(Net::MSG_TX, vHashes[i]);
+			for (unsigned int n = 0; n < vPeers.size(); n++)
+			{
+				if ((i + n) % 4 == 0)
+					vPeers[n]->AddInventoryKnown(inv);
+					
+				vPeers[n]->PushInventory(inv);
+			}
+			
+			/** One Message Handler pass per Transaction. The Timers are forced every 100 Transactions,
+				about one trickle interval at 20 Transactions a second. **/
+			BOOST_FOREACH(Net::CNode* pnode, vPeers)
+			{
+				if (i % 100 == 99)
+					pnode->nNextInvSend = 0;
+					
+				LOCK(pnode->cs_vSend);
+				SendMessages(pnode);
+			}
+		}
+		double dMicros = (double)(clock() - nStart) * 1000000.0 / CLOCKS_PER_SEC;
+		
+		uint64 nMessages = 0;
+		BOOST_FOREACH(Net::CNode* pnode, vPeers)
+		{
+			nMessages += pnode->vSendMsg.size();
+			delete pnode;
+		}
+		
+		printf("bench relay: %u transactions to %u peers in %" PRI64u " messages, %.1f us cpu per transaction, %.2f us per peer\n",
+			nTransactions, nPeers, nMessages, dMicros / nTransactions, dMicros / nTransactions / nPeers);
+	}
 
 }
 
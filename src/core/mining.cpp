@@ -38,11 +38,11 @@ namespace LLP
 		
 		
 		/** Constructor to Class. **/
-		Coinbase(std::vector<unsigned char> vData, uint64 nValue){ Deserialize(vData, nValue); }
+		Coinbase(const std::vector<unsigned char>& vData, uint64 nValue){ Deserialize(vData, nValue); }
 		
 		
 		/** Deserialize the Coinbase Transaction. **/
-		void Deserialize(std::vector<unsigned char> vData, uint64 nValue)
+		void Deserialize(const std::vector<unsigned char>& vData, uint64 nValue)
 		{
 			/** Set the Max Value for this Transaction. **/
 			nMaxValue = nValue;
@@ -81,6 +81,16 @@ namespace LLP
 			return nCurrentValue == nMaxValue;
 		}
 		
+		/** Identity of the Payout. Connections that set the same Coinbase share a Push Work Template. **/
+		std::string GetKey() const
+		{
+			std::string strKey = strprintf("%" PRIu64, nPoolFee);
+			for(std::map<std::string, uint64>::const_iterator nIterator = vOutputs.begin(); nIterator != vOutputs.end(); nIterator++)
+				strKey += strprintf(" %s:%" PRIu64, nIterator->first.c_str(), nIterator->second);
+				
+			return strKey;
+		}
+		
 		/** Output the Transactions in the Coinbase Container. **/
 		void Print()
 		{
@@ -100,6 +110,429 @@ namespace LLP
 		}
 		
 	};
+		
+	/** Convert the Header of a Block into a Byte Stream for Reading and Writing Across Sockets. **/
+	std::vector<unsigned char> SerializeBlock(Core::CBlock* BLOCK)
+	{
+		std::vector<unsigned char> VERSION  = uint2bytes(BLOCK->nVersion);
+		std::vector<unsigned char> PREVIOUS = BLOCK->hashPrevBlock.GetBytes();
+		std::vector<unsigned char> MERKLE   = BLOCK->hashMerkleRoot.GetBytes();
+		std::vector<unsigned char> CHANNEL  = uint2bytes(BLOCK->nChannel);
+		std::vector<unsigned char> HEIGHT   = uint2bytes(BLOCK->nHeight);
+		std::vector<unsigned char> BITS     = uint2bytes(BLOCK->nBits);
+		std::vector<unsigned char> NONCE    = uint2bytes64(BLOCK->nNonce);
+		
+		std::vector<unsigned char> DATA;
+		DATA.insert(DATA.end(), VERSION.begin(),   VERSION.end());
+		DATA.insert(DATA.end(), PREVIOUS.begin(), PREVIOUS.end());
+		DATA.insert(DATA.end(), MERKLE.begin(),     MERKLE.end());
+		DATA.insert(DATA.end(), CHANNEL.begin(),   CHANNEL.end());
+		DATA.insert(DATA.end(), HEIGHT.begin(),     HEIGHT.end());
+		DATA.insert(DATA.end(), BITS.begin(),         BITS.end());
+		DATA.insert(DATA.end(), NONCE.begin(),       NONCE.end());
+		
+		return DATA;
+	}
+	
+	
+	/** Shared Block Templates for Push Mining. One Block is created per Channel and Payout each Round, and each Worker
+		is given its own Range of Nonces to search in it. Connections without a Coinbase share the Template paying this
+		Node's Wallet, Connections that set a Coinbase share the Template paying that Coinbase. **/
+	class MiningTemplates
+	{
+		Mutex_t MUTEX;
+		
+		/** Template Block, its ID, Serialized Header without the Nonce, and the Next Free Nonce. **/
+		struct Template
+		{
+			Core::CBlock* pblock;
+			unsigned int nID;
+			std::vector<unsigned char> vHeader;
+			uint64 nNextNonce;
+			
+			Template() : pblock(NULL), nID(0), nNextNonce(0) { }
+		};
+		
+		/** The Round the Templates were Created for, and the Templates by Channel and Payout Key. The empty Key pays this Node's Wallet. **/
+		Core::CBlockIndex* pindexRound;
+		std::map<std::pair<unsigned int, std::string>, Template> mapTemplates;
+		
+		/** Template IDs are unique for the life of the Server. **/
+		unsigned int nLastID;
+		
+		Wallet::CReserveKey* pMiningKey;
+		
+		void Clear()
+		{
+			for(std::map<std::pair<unsigned int, std::string>, Template>::iterator it = mapTemplates.begin(); it != mapTemplates.end(); ++it)
+				delete it->second.pblock;
+				
+			mapTemplates.clear();
+		}
+		
+		/** Current Template with the given ID. NULL if it was Rolled or the Round is over. **/
+		Template* Find(unsigned int nChannel, unsigned int nID)
+		{
+			if(pindexRound != Core::pindexBest)
+				return NULL;
+				
+			for(std::map<std::pair<unsigned int, std::string>, Template>::iterator it = mapTemplates.begin(); it != mapTemplates.end(); ++it)
+				if(it->first.first == nChannel && it->second.nID == nID)
+					return &it->second;
+					
+			return NULL;
+		}
+		
+	public:
+	
+		/** Size of the Nonce Range given to each Worker. Leaves room for 2^24 Workers a Round. **/
+		static const uint64 NONCE_RANGE = ((uint64)1 << 40);
+		
+		/** Most Templates a Round, so Connections changing their Coinbase cannot have a Block Created for every Request. **/
+		static const unsigned int MAX_TEMPLATES = 64;
+		
+		MiningTemplates() : pindexRound(NULL), nLastID(0), pMiningKey(NULL) { }
+		
+		
+		/** Get the Work for a Worker. The Template for the Channel and Payout is only Created by the first Worker of the Round asking for it.
+			Returns the Packet Data: Template ID, Block Header with the Range Start as Nonce, and the Range End. **/
+		bool GetWork(unsigned int nChannel, Coinbase* pCoinbase, unsigned int& nID, uint64& nNonceBegin, uint64& nNonceEnd, std::vector<unsigned char>& vData)
+		{
+			if(nChannel != 1 && nChannel != 2)
+				return false;
+				
+			LOCK_GUARD(MUTEX);
+			if(pindexRound != Core::pindexBest)
+			{
+				Clear();
+				pindexRound = Core::pindexBest;
+			}
+			
+			std::pair<unsigned int, std::string> KEY = std::make_pair(nChannel, pCoinbase ? pCoinbase->GetKey() : std::string());
+			if(!mapTemplates.count(KEY) && mapTemplates.size() >= MAX_TEMPLATES)
+				return error("Mining LLP : Too many Work Templates this Round");
+				
+			Template& TEMPLATE = mapTemplates[KEY];
+			
+			/** Once the Nonce Space of a Template is given out, Roll a new one rather than hand out Ranges that Overlap. **/
+			if(TEMPLATE.pblock && TEMPLATE.nNextNonce > std::numeric_limits<uint64>::max() - NONCE_RANGE)
+			{
+				delete TEMPLATE.pblock;
+				TEMPLATE.pblock = NULL;
+				TEMPLATE.vHeader.clear();
+			}
+			
+			if(!TEMPLATE.pblock)
+			{
+				if(!pMiningKey)
+					pMiningKey = new Wallet::CReserveKey(pwalletMain);
+					
+				/** The Template ID goes into the Coinbase, so a Template Rolled in the same Round has its own Merkle Root.
+					A Coinbase that does not pay the Reward of this Round fails here, as it does for GET_BLOCK. **/
+				TEMPLATE.pblock = Core::CreateNewBlock(*pMiningKey, pwalletMain, nChannel, nLastID + 1, pCoinbase);
+				if(!TEMPLATE.pblock)
+				{
+					mapTemplates.erase(KEY);
+					
+					return false;
+				}
+				
+				TEMPLATE.vHeader = SerializeBlock(TEMPLATE.pblock);
+				TEMPLATE.vHeader.resize(TEMPLATE.vHeader.size() - 8);
+				
+				TEMPLATE.nID        = ++nLastID;
+				TEMPLATE.nNextNonce = TEMPLATE.pblock->nNonce;
+				
+				printf("%%%%%%%%%% Mining LLP: New %s Template %u for Round %u%s\n", Core::GetChannelName(nChannel).c_str(), nLastID, TEMPLATE.pblock->nHeight, pCoinbase ? " with Coinbase" : "");
+			}
+			
+			nID         = TEMPLATE.nID;
+			nNonceBegin = TEMPLATE.nNextNonce;
+			nNonceEnd   = nNonceBegin + NONCE_RANGE;
+			TEMPLATE.nNextNonce = nNonceEnd;
+			
+			std::vector<unsigned char> ID    = uint2bytes(nID);
+			std::vector<unsigned char> BEGIN = uint2bytes64(nNonceBegin);
+			std::vector<unsigned char> END   = uint2bytes64(nNonceEnd);
+			
+			vData.clear();
+			vData.insert(vData.end(), ID.begin(), ID.end());
+			vData.insert(vData.end(), TEMPLATE.vHeader.begin(), TEMPLATE.vHeader.end());
+			vData.insert(vData.end(), BEGIN.begin(), BEGIN.end());
+			vData.insert(vData.end(), END.begin(), END.end());
+			
+			return true;
+		}
+		
+		
+		/** Copy the Header of a Template for Share Verification. Fails if the Template is no longer Current. **/
+		bool GetHeader(unsigned int nChannel, unsigned int nID, Core::CBlock& header)
+		{
+			LOCK_GUARD(MUTEX);
+			Template* pTemplate = Find(nChannel, nID);
+			if(!pTemplate)
+				return false;
+				
+			const Core::CBlock* pblock = pTemplate->pblock;
+			header.SetNull();
+			header.nVersion       = pblock->nVersion;
+			header.hashPrevBlock  = pblock->hashPrevBlock;
+			header.hashMerkleRoot = pblock->hashMerkleRoot;
+			header.nChannel       = pblock->nChannel;
+			header.nHeight        = pblock->nHeight;
+			header.nBits          = pblock->nBits;
+			header.nNonce         = pblock->nNonce;
+			header.nTime          = pblock->nTime;
+			
+			return true;
+		}
+		
+		
+		/** Submit a Nonce for a Template. Only Current Templates are Accepted. **/
+		bool SubmitWork(unsigned int nChannel, unsigned int nID, uint64 nNonce)
+		{
+			LOCK_GUARD(MUTEX);
+			Template* pTemplate = Find(nChannel, nID);
+			if(!pTemplate)
+				return error("Mining LLP : Stale Template %u", nID);
+			
+			/** Work on a Copy so the Template stays Clean for other Workers. **/
+			Core::CBlock block(*pTemplate->pblock);
+			block.nNonce = nNonce;
+			block.UpdateTime();
+			
+			if(!block.SignBlock(*pwalletMain) || !Core::CheckWork(&block, *pwalletMain, *pMiningKey))
+				return false;
+				
+			/** The Block was Accepted, so this Key was used and the Round is over. **/
+			delete pMiningKey;
+			pMiningKey = NULL;
+			
+			Clear();
+			
+			return true;
+		}
+	};
+	
+	MiningTemplates cMiningTemplates;
+	
+	
+	/** A Share submitted by a Worker. Holds only the Block Header, with the Result filled in by the Verifier. **/
+	class WorkerStats;
+	struct ShareJob
+	{
+		boost::shared_ptr<WorkerStats> pStats;
+		Core::CBlock BLOCK;
+		
+		/** Push Work Template, or 0 if the Block is from the Connection's MAP_BLOCKS. **/
+		unsigned int nTemplateID;
+		
+		/** Set by the Verifier: Share meets the Share Target, or even the Block Target. **/
+		bool fValid, fBlock;
+		double dWork;
+		
+		ShareJob() : nTemplateID(0), fValid(false), fBlock(false), dWork(0.0) { }
+	};
+	
+	
+	/** Share and Hashrate Counters of one Worker Connection. Shared with the Share Verifiers,
+		which can finish a Share after its Connection is gone. **/
+	class WorkerStats
+	{
+	public:
+		Mutex_t MUTEX;
+		
+		std::string strAddress;
+		unsigned int nChannel;
+		uint64 nShares, nRejected, nBlocks;
+		
+		/** Expected Hashes behind the Accepted Shares [Hash Channel], or Sum of their Cluster Difficulty [Prime Channel]. **/
+		double dWork;
+		
+		Timer TIMER;
+		
+		/** Verified Shares waiting for the Data Thread to Answer them. **/
+		std::deque<ShareJob> RESULTS;
+		
+		WorkerStats() : nChannel(0), nShares(0), nRejected(0), nBlocks(0), dWork(0.0) { TIMER.Start(); }
+		
+		void GetStats(Core::CMiningStats& stats)
+		{
+			LOCK_GUARD(MUTEX);
+			
+			stats.strAddress  = strAddress;
+			stats.nChannel    = nChannel;
+			stats.nShares     = nShares;
+			stats.nRejected   = nRejected;
+			stats.nBlocks     = nBlocks;
+			stats.nConnected  = TIMER.Elapsed();
+			
+			double dSeconds   = std::max(1u, TIMER.ElapsedMilliseconds()) / 1000.0;
+			stats.dShareRate  = nShares / dSeconds;
+			stats.dHashRate   = (nChannel == 2) ? dWork / dSeconds : 0.0;
+			stats.dDifficulty = (nChannel == 1 && nShares > 0) ? dWork / nShares : 0.0;
+		}
+	};
+	
+	
+	/** Workers Connected to the Mining LLP, for the Stats RPC. **/
+	static Mutex_t STATS_MUTEX;
+	static std::set< boost::shared_ptr<WorkerStats> > setWorkerStats;
+	
+	
+	/** Expected number of Hashes to find one below the given Target. **/
+	static double GetHashesForTarget(const CBigNum& bnTarget)
+	{
+		unsigned int nCompact = bnTarget.GetCompact();
+		double dMantissa = (double)(nCompact & 0x007fffff);
+		if(dMantissa == 0.0)
+			return 0.0;
+			
+		int nShift = 8 * ((int)(nCompact >> 24) - 3);
+		return exp2(1024.0 - (log2(dMantissa) + nShift));
+	}
+	
+	
+	/** Pool of Threads that Verify Shares against the Share Targets. Only needs the Block Header, so
+		it never takes cs_main, and the Prime Tests of the Prime Channel stay off the Data Threads.
+		
+		-mining_sharefactor: Hash Channel Shares have a Target this many times the Block Target.
+		-mining_primeshare:  Minimum Cluster Difficulty of Prime Channel Shares. 
+		-mining_sharethreads: Number of Verifier Threads. **/
+	class ShareVerifier
+	{
+		Mutex_t MUTEX;
+		boost::condition_variable CONDITION;
+		std::deque<ShareJob> QUEUE;
+		boost::thread_group THREADS;
+		bool fStarted;
+		
+		/** Merkle Root and Nonce of every Share taken this Round, so a Share is only Counted once.
+			Merkle Roots are unique to a Block of MAP_BLOCKS or a Template, so they stand in for either. **/
+		std::set< std::pair<uint512, uint64> > setAccepted;
+		uint1024 hashRound;
+		
+		void Verify(ShareJob& JOB)
+		{
+			if(JOB.BLOCK.GetChannel() == 1)
+			{
+				unsigned int nPrimeBits = Core::GetPrimeBits(JOB.BLOCK.GetPrime());
+				
+				JOB.fValid = (nPrimeBits >= nPrimeShareBits);
+				JOB.fBlock = (nPrimeBits >= JOB.BLOCK.nBits);
+				JOB.dWork  = nPrimeBits / 10000000.0;
+				
+				return;
+			}
+			
+			CBigNum bnTarget;
+			bnTarget.SetCompact(JOB.BLOCK.nBits);
+			
+			CBigNum bnShare = bnTarget * CBigNum(nShareFactor);
+			if(bnShare > Core::bnProofOfWorkLimit[2])
+				bnShare = Core::bnProofOfWorkLimit[2];
+				
+			uint1024 hash = JOB.BLOCK.GetHash();
+			JOB.fValid = (hash <= bnShare.getuint1024());
+			JOB.fBlock = (hash <= bnTarget.getuint1024());
+			JOB.dWork  = GetHashesForTarget(bnShare);
+		}
+		
+		void Thread()
+		{
+			while(!fShutdown)
+			{
+				ShareJob JOB;
+				{
+					boost::unique_lock<boost::mutex> lock(MUTEX);
+					while(QUEUE.empty() && !fShutdown)
+						CONDITION.timed_wait(lock, boost::posix_time::milliseconds(1000));
+						
+					if(QUEUE.empty())
+						return;
+						
+					JOB = QUEUE.front();
+					QUEUE.pop_front();
+				}
+				
+				Verify(JOB);
+				
+				LOCK_GUARD(JOB.pStats->MUTEX);
+				JOB.pStats->RESULTS.push_back(JOB);
+			}
+		}
+		
+	public:
+	
+		/** Shares waiting beyond this are Rejected straight away. **/
+		static const unsigned int MAX_QUEUE = 10000;
+		
+		unsigned int nShareFactor, nPrimeShareBits;
+		
+		ShareVerifier() : fStarted(false), nShareFactor(0), nPrimeShareBits(0) { }
+		
+		/** Share Mode is Enabled for a Channel when its Share Target is Configured. **/
+		bool Enabled(unsigned int nChannel)
+		{
+			Start();
+			
+			return (nChannel == 1 && nPrimeShareBits > 0) || (nChannel == 2 && nShareFactor > 0);
+		}
+		
+		/** Read the Share Targets on first use. The Threads are only Created if a Channel has Share Mode Enabled. **/
+		void Start()
+		{
+			LOCK_GUARD(MUTEX);
+			if(fStarted)
+				return;
+				
+			fStarted = true;
+			nShareFactor    = GetArg("-mining_sharefactor", 0);
+			nPrimeShareBits = Core::SetBits(atof(GetArg("-mining_primeshare", "0").c_str()));
+			if(nShareFactor == 0 && nPrimeShareBits == 0)
+				return;
+			
+			for(int nThread = 0; nThread < GetArg("-mining_sharethreads", 2); nThread++)
+				THREADS.create_thread(boost::bind(&ShareVerifier::Thread, this));
+		}
+		
+		/** Wake the Threads so they see fShutdown, and wait for them to Exit. **/
+		void Stop()
+		{
+			CONDITION.notify_all();
+			THREADS.join_all();
+		}
+		
+		/** Queue a Share. Fails on a full Queue, a Share from a past Round, or a Share already taken this Round. **/
+		bool Push(const ShareJob& JOB)
+		{
+			{
+				LOCK_GUARD(MUTEX);
+				if(QUEUE.size() >= MAX_QUEUE)
+					return false;
+					
+				uint1024 hashBest = Core::pindexBest->GetBlockHash();
+				if(hashBest != hashRound)
+				{
+					setAccepted.clear();
+					hashRound = hashBest;
+				}
+				
+				if(JOB.BLOCK.hashPrevBlock != hashRound)
+					return false;
+					
+				if(!setAccepted.insert(std::make_pair(JOB.BLOCK.hashMerkleRoot, JOB.BLOCK.nNonce)).second)
+					return false;
+					
+				QUEUE.push_back(JOB);
+			}
+			
+			CONDITION.notify_one();
+			return true;
+		}
+	};
+	
+	ShareVerifier cShareVerifier;
 	
 
 	class MiningLLP : public Connection
@@ -114,6 +547,14 @@ namespace LLP
 		/** Subscribed To Display how many Blocks connection Subscribed to. **/
 		unsigned int nSubscribed = 0;
 		
+		/** Share and Hashrate Counters of this Worker. **/
+		boost::shared_ptr<WorkerStats> pStats;
+		
+		/** Push Work: the Shared Template and Nonce Range this Worker was given. **/
+		bool fPushWork = false;
+		unsigned int nTemplateID = 0;
+		uint64 nNonceBegin = 0, nNonceEnd = 0;
+		
 		enum
 		{
 			/** DATA PACKETS **/
@@ -125,11 +566,15 @@ namespace LLP
 			SET_COINBASE = 5,
 			GOOD_BLOCK   = 6,
 			ORPHAN_BLOCK = 7,
+			WORK_DATA    = 8,
+			WORKER_STATS = 9,
 			
 			
 			/** DATA REQUESTS **/
 			CHECK_BLOCK  = 64,
 			SUBSCRIBE    = 65,
+			SUBMIT_WORK  = 66,
+			SUBMIT_SHARE = 67,
 					
 					
 			/** REQUEST PACKETS **/
@@ -141,6 +586,8 @@ namespace LLP
 			/** SERVER COMMANDS **/
 			CLEAR_MAP    = 132,
 			GET_ROUND    = 133,
+			SUBSCRIBE_WORK = 134,
+			GET_STATS    = 135,
 			
 			
 			/** RESPONSE PACKETS **/
@@ -155,6 +602,10 @@ namespace LLP
 			/** ROUND VALIDATIONS. **/
 			NEW_ROUND     = 204,
 			OLD_ROUND     = 205,
+			
+			/** SHARE VALIDATIONS. **/
+			SHARE_ACCEPTED = 206,
+			SHARE_REJECTED = 207,
 					
 			/** GENERIC **/
 			PING     = 253,
@@ -162,11 +613,25 @@ namespace LLP
 		};
 	
 	public:
-		MiningLLP() : Connection(){ pMiningKey = new Wallet::CReserveKey(pwalletMain); nChannel = 0; nBestHeight = 0; }
-		MiningLLP( Socket_t SOCKET_IN, DDOS_Filter* DDOS_IN, bool isDDOS = false ) : Connection( SOCKET_IN, DDOS_IN ) { pMiningKey = new Wallet::CReserveKey(pwalletMain); nChannel = 0; nBestHeight = 0; }
+		MiningLLP() : Connection(), pStats(new WorkerStats()) { pMiningKey = new Wallet::CReserveKey(pwalletMain); nChannel = 0; nBestHeight = 0; }
+		MiningLLP( Socket_t SOCKET_IN, DDOS_Filter* DDOS_IN, bool isDDOS = false ) : Connection( SOCKET_IN, DDOS_IN ), pStats(new WorkerStats())
+		{
+			pMiningKey = new Wallet::CReserveKey(pwalletMain); nChannel = 0; nBestHeight = 0;
+			
+			/** Register the Worker for the Stats RPC. **/
+			try { pStats->strAddress = SOCKET_IN->remote_endpoint().address().to_string(); } catch(...) { }
+			
+			LOCK_GUARD(STATS_MUTEX);
+			setWorkerStats.insert(pStats);
+		}
 		
 		~MiningLLP()
 		{
+			{
+				LOCK_GUARD(STATS_MUTEX);
+				setWorkerStats.erase(pStats);
+			}
+			
 			for(map<uint512, Core::CBlock*>::iterator IT = MAP_BLOCKS.begin(); IT != MAP_BLOCKS.end(); ++ IT)
 			{
 				printf("%%%%%%%%%% Mining LLP: Deleting Block %s\n", IT->second->hashMerkleRoot.ToString().substr(0, 10).c_str());
@@ -196,7 +661,7 @@ namespace LLP
 			{
 				if(fDDOS)
 				{
-					Packet PACKET   = this->INCOMING;
+					const Packet& PACKET = this->INCOMING;
 					if(PACKET.HEADER == BLOCK_DATA)
 						DDOS->Ban();
 					
@@ -221,6 +686,24 @@ namespace LLP
 					if(PACKET.HEADER == ORPHAN_BLOCK)
 						DDOS->Ban();
 					
+					if(PACKET.HEADER == WORK_DATA)
+						DDOS->Ban();
+					
+					if(PACKET.HEADER == SUBMIT_WORK && PACKET.LENGTH > 12)
+						DDOS->Ban();
+					
+					if(PACKET.HEADER == WORKER_STATS)
+						DDOS->Ban();
+					
+					if(PACKET.HEADER == SUBMIT_SHARE && PACKET.LENGTH != 72 && PACKET.LENGTH != 12)
+						DDOS->Ban();
+					
+					if(PACKET.HEADER == SHARE_ACCEPTED)
+						DDOS->Ban();
+					
+					if(PACKET.HEADER == SHARE_REJECTED)
+						DDOS->Ban();
+					
 					if(PACKET.HEADER == CHECK_BLOCK && PACKET.LENGTH > 128)
 						DDOS->Ban();
 					
@@ -257,6 +740,21 @@ namespace LLP
 			/** On Generic Event, Broadcast new block if flagged. **/
 			if(EVENT == EVENT_GENERIC)
 			{
+				/** Answer the Shares the Verifiers have finished. **/
+				AnswerShares();
+				
+				/** Push the Shared Template of a new Round to Push Work Workers. **/
+				if(fPushWork)
+				{
+					if(pindexBest != Core::pindexBest)
+					{
+						pindexBest = Core::pindexBest;
+						SendWork();
+					}
+					
+					return;
+				}
+				
 				/** Skip Generic Event if not Subscribed to Work. **/
 				if(nSubscribed == 0)
 					return;
@@ -311,7 +809,7 @@ namespace LLP
 			custom messaging system, and how to interpret it from raw packets. **/
 		bool ProcessPacket()
 		{
-			Packet PACKET   = this->INCOMING;
+			const Packet& PACKET = this->INCOMING;
 			
 			
 			/** If There are no Active nodes, or it is Initial Block Download:
@@ -330,6 +828,11 @@ namespace LLP
 				
 				printf("%%%%%%%%%% Mining LLP: Channel Set %u\n", nChannel); 
 				
+				{
+					LOCK_GUARD(pStats->MUTEX);
+					pStats->nChannel = nChannel;
+				}
+				
 				return true; 
 			}
 			
@@ -464,6 +967,47 @@ namespace LLP
 				return true; 
 			}
 			
+			/** Subscribe to Push Work:
+				Worker is sent the Shared Template with a new Nonce Range now, and on every new Round.
+				Sending it again requests a new Nonce Range once the last one is searched. **/
+			if(PACKET.HEADER == SUBSCRIBE_WORK)
+			{
+				if(nChannel == 0)
+					return false;
+					
+				fPushWork   = true;
+				pindexBest  = Core::pindexBest;
+				SendWork();
+				
+				return true;
+			}
+			
+			
+			/** Submit Work Process:
+				Accepts the Template ID and nNonce of Push Work. The Nonce must be
+				inside the Range given to this Worker for the Template. **/
+			if(PACKET.HEADER == SUBMIT_WORK)
+			{
+				if(PACKET.LENGTH != 12)
+					return false;
+					
+				unsigned int nID = bytes2uint(PACKET.DATA);
+				uint64 nNonce    = bytes2uint64(PACKET.DATA, 4);
+				
+				Packet RESPONSE;
+				RESPONSE.HEADER = BLOCK_REJECTED;
+				if(fPushWork && nID == nTemplateID && nNonce >= nNonceBegin && nNonce < nNonceEnd && cMiningTemplates.SubmitWork(nChannel, nID, nNonce))
+				{
+					printf("%%%%%%%%%% Mining LLP: Accepted Work for Template %u\n", nID);
+					RESPONSE.HEADER = BLOCK_ACCEPTED;
+				}
+				
+				this->WritePacket(RESPONSE);
+				
+				return true;
+			}
+			
+			
 			/** New block Process:
 				Keeps a map of requested blocks for this connection.
 				Clears map once new block is submitted successfully. **/
@@ -503,32 +1047,102 @@ namespace LLP
 				uint512 hashMerkleRoot;
 				hashMerkleRoot.SetBytes(std::vector<unsigned char>(PACKET.DATA.begin(), PACKET.DATA.end() - 8));
 				
-				if(!MAP_BLOCKS.count(hashMerkleRoot))
+				Packet RESPONSE;
+				RESPONSE.HEADER = BLOCK_REJECTED;
+				if(SubmitMapBlock(hashMerkleRoot, bytes2uint64(std::vector<unsigned char>(PACKET.DATA.end() - 8, PACKET.DATA.end()))))
+					RESPONSE.HEADER = BLOCK_ACCEPTED;
+				
+				this->WritePacket(RESPONSE);
+				
+				return true;
+			}
+			
+			
+			/** Submit Share Process:
+				Accepts the same Data as SUBMIT_BLOCK [Merkle Root and nNonce], or as SUBMIT_WORK [Template ID and nNonce].
+				The Share is Verified by the Share Verifiers and Answered from the Generic Event once done. 
+				A Share that also meets the Block Target is Submitted as a Block. **/
+			if(PACKET.HEADER == SUBMIT_SHARE)
+			{
+				if(PACKET.LENGTH != 72 && PACKET.LENGTH != 12)
+					return false;
+					
+				ShareJob JOB;
+				JOB.pStats = pStats;
+				
+				bool fFound = false;
+				if(cShareVerifier.Enabled(nChannel))
 				{
-					Packet RESPONSE;
-					RESPONSE.HEADER = BLOCK_REJECTED;
+					if(PACKET.LENGTH == 72)
+					{
+						uint512 hashMerkleRoot;
+						hashMerkleRoot.SetBytes(std::vector<unsigned char>(PACKET.DATA.begin(), PACKET.DATA.end() - 8));
+						
+						map<uint512, Core::CBlock*>::iterator IT = MAP_BLOCKS.find(hashMerkleRoot);
+						if(IT != MAP_BLOCKS.end())
+						{
+							Core::CBlock* BLOCK = IT->second;
+							
+							JOB.BLOCK.nVersion       = BLOCK->nVersion;
+							JOB.BLOCK.hashPrevBlock  = BLOCK->hashPrevBlock;
+							JOB.BLOCK.hashMerkleRoot = BLOCK->hashMerkleRoot;
+							JOB.BLOCK.nChannel       = BLOCK->nChannel;
+							JOB.BLOCK.nHeight        = BLOCK->nHeight;
+							JOB.BLOCK.nBits          = BLOCK->nBits;
+							JOB.BLOCK.nTime          = BLOCK->nTime;
+							JOB.BLOCK.nNonce         = bytes2uint64(PACKET.DATA, 64);
+							
+							fFound = true;
+						}
+					}
+					else if(PACKET.LENGTH == 12 && fPushWork)
+					{
+						JOB.nTemplateID = bytes2uint(PACKET.DATA);
+						
+						uint64 nNonce = bytes2uint64(PACKET.DATA, 4);
+						fFound = (JOB.nTemplateID == nTemplateID && nNonce >= nNonceBegin && nNonce < nNonceEnd && cMiningTemplates.GetHeader(nChannel, JOB.nTemplateID, JOB.BLOCK));
+						JOB.BLOCK.nNonce = nNonce;
+					}
+				}
+				
+				if(!fFound || !cShareVerifier.Push(JOB))
+				{
+					{
+						LOCK_GUARD(pStats->MUTEX);
+						pStats->nRejected++;
+					}
 					
+					Packet RESPONSE;
+					RESPONSE.HEADER = SHARE_REJECTED;
 					this->WritePacket(RESPONSE);
-					
-					printf("%%%%%%%%%% Mining LLP: Block Not Found %s\n", hashMerkleRoot.ToString().substr(0, 20).c_str());
-					return true;
 				}
 				
-				Core::CBlock* NEW_BLOCK = MAP_BLOCKS[hashMerkleRoot];
-				NEW_BLOCK->nNonce = bytes2uint64(std::vector<unsigned char>(PACKET.DATA.end() - 8, PACKET.DATA.end()));
-				NEW_BLOCK->UpdateTime();
-				NEW_BLOCK->print();
+				return true;
+			}
+			
+			
+			/** Get Stats Process:
+				Responds with this Worker's Accepted and Rejected Shares, Blocks Found, 
+				Estimated Hashes per Second, and Seconds Connected. **/
+			if(PACKET.HEADER == GET_STATS)
+			{
+				Core::CMiningStats STATS;
+				pStats->GetStats(STATS);
+				
+				std::vector<unsigned char> SHARES    = uint2bytes64(STATS.nShares);
+				std::vector<unsigned char> REJECTED  = uint2bytes64(STATS.nRejected);
+				std::vector<unsigned char> BLOCKS    = uint2bytes64(STATS.nBlocks);
+				std::vector<unsigned char> HASHRATE  = uint2bytes64((uint64)STATS.dHashRate);
+				std::vector<unsigned char> CONNECTED = uint2bytes(STATS.nConnected);
 				
 				Packet RESPONSE;
-				if(NEW_BLOCK->SignBlock(*pwalletMain) && Core::CheckWork(NEW_BLOCK, *pwalletMain, *pMiningKey))
-				{
-					printf("%%%%%%%%%% Mining LLP: Created New Block %s\n", NEW_BLOCK->hashMerkleRoot.ToString().substr(0, 10).c_str());
-					RESPONSE.HEADER = BLOCK_ACCEPTED;
-					
-					ClearMap();
-				}
-				else
-					RESPONSE.HEADER = BLOCK_REJECTED;
+				RESPONSE.HEADER = WORKER_STATS;
+				RESPONSE.DATA.insert(RESPONSE.DATA.end(), SHARES.begin(),    SHARES.end());
+				RESPONSE.DATA.insert(RESPONSE.DATA.end(), REJECTED.begin(),  REJECTED.end());
+				RESPONSE.DATA.insert(RESPONSE.DATA.end(), BLOCKS.begin(),    BLOCKS.end());
+				RESPONSE.DATA.insert(RESPONSE.DATA.end(), HASHRATE.begin(),  HASHRATE.end());
+				RESPONSE.DATA.insert(RESPONSE.DATA.end(), CONNECTED.begin(), CONNECTED.end());
+				RESPONSE.LENGTH = RESPONSE.DATA.size();
 				
 				this->WritePacket(RESPONSE);
 				
@@ -561,27 +1175,87 @@ namespace LLP
 		
 	private:
 	
-		/** Convert the Header of a Block into a Byte Stream for Reading and Writing Across Sockets. **/
-		std::vector<unsigned char> SerializeBlock(Core::CBlock* BLOCK)
+		/** Submit a Nonce for a Block of MAP_BLOCKS. **/
+		bool SubmitMapBlock(const uint512& hashMerkleRoot, uint64 nNonce)
+		{
+			if(!MAP_BLOCKS.count(hashMerkleRoot))
+			{
+				printf("%%%%%%%%%% Mining LLP: Block Not Found %s\n", hashMerkleRoot.ToString().substr(0, 20).c_str());
+				return false;
+			}
+			
+			Core::CBlock* NEW_BLOCK = MAP_BLOCKS[hashMerkleRoot];
+			NEW_BLOCK->nNonce = nNonce;
+			NEW_BLOCK->UpdateTime();
+			NEW_BLOCK->print();
+			
+			if(!NEW_BLOCK->SignBlock(*pwalletMain) || !Core::CheckWork(NEW_BLOCK, *pwalletMain, *pMiningKey))
+				return false;
+				
+			printf("%%%%%%%%%% Mining LLP: Created New Block %s\n", NEW_BLOCK->hashMerkleRoot.ToString().substr(0, 10).c_str());
+			ClearMap();
+			
+			return true;
+		}
+		
+		
+		/** Answer the Verified Shares of this Worker, and Submit those that meet the Block Target. **/
+		void AnswerShares()
+		{
+			std::deque<ShareJob> RESULTS;
+			{
+				LOCK_GUARD(pStats->MUTEX);
+				if(pStats->RESULTS.empty())
+					return;
+					
+				RESULTS.swap(pStats->RESULTS);
+			}
+			
+			for(std::deque<ShareJob>::iterator JOB = RESULTS.begin(); JOB != RESULTS.end(); ++JOB)
+			{
+				Packet RESPONSE;
+				RESPONSE.HEADER = JOB->fValid ? SHARE_ACCEPTED : SHARE_REJECTED;
+				this->WritePacket(RESPONSE);
+				
+				bool fBlock = false;
+				if(JOB->fValid && JOB->fBlock)
+				{
+					fBlock = JOB->nTemplateID ? cMiningTemplates.SubmitWork(nChannel, JOB->nTemplateID, JOB->BLOCK.nNonce) : SubmitMapBlock(JOB->BLOCK.hashMerkleRoot, JOB->BLOCK.nNonce);
+					
+					Packet BLOCK;
+					BLOCK.HEADER = fBlock ? BLOCK_ACCEPTED : BLOCK_REJECTED;
+					this->WritePacket(BLOCK);
+				}
+				
+				LOCK_GUARD(pStats->MUTEX);
+				if(!JOB->fValid)
+				{
+					pStats->nRejected++;
+					continue;
+				}
+				
+				pStats->nShares++;
+				pStats->dWork += JOB->dWork;
+				if(fBlock)
+					pStats->nBlocks++;
+			}
+		}
+		
+		
+		/** Send the Shared Template for this Channel with a fresh Nonce Range. **/
+		void SendWork()
 		{
-			std::vector<unsigned char> VERSION  = uint2bytes(BLOCK->nVersion);
-			std::vector<unsigned char> PREVIOUS = BLOCK->hashPrevBlock.GetBytes();
-			std::vector<unsigned char> MERKLE   = BLOCK->hashMerkleRoot.GetBytes();
-			std::vector<unsigned char> CHANNEL  = uint2bytes(BLOCK->nChannel);
-			std::vector<unsigned char> HEIGHT   = uint2bytes(BLOCK->nHeight);
-			std::vector<unsigned char> BITS     = uint2bytes(BLOCK->nBits);
-			std::vector<unsigned char> NONCE    = uint2bytes64(BLOCK->nNonce);
-			
-			std::vector<unsigned char> DATA;
-			DATA.insert(DATA.end(), VERSION.begin(),   VERSION.end());
-			DATA.insert(DATA.end(), PREVIOUS.begin(), PREVIOUS.end());
-			DATA.insert(DATA.end(), MERKLE.begin(),     MERKLE.end());
-			DATA.insert(DATA.end(), CHANNEL.begin(),   CHANNEL.end());
-			DATA.insert(DATA.end(), HEIGHT.begin(),     HEIGHT.end());
-			DATA.insert(DATA.end(), BITS.begin(),         BITS.end());
-			DATA.insert(DATA.end(), NONCE.begin(),       NONCE.end());
-			
-			return DATA;
+			Packet RESPONSE;
+			if(!cMiningTemplates.GetWork(nChannel, pCoinbaseTx, nTemplateID, nNonceBegin, nNonceEnd, RESPONSE.DATA))
+			{
+				printf("%%%%%%%%%% Mining LLP: Could not Create Work Template.\n");
+				return;
+			}
+			
+			RESPONSE.HEADER = WORK_DATA;
+			RESPONSE.LENGTH = RESPONSE.DATA.size();
+			
+			this->WritePacket(RESPONSE);
 		}
 	};
 }
@@ -597,31 +1271,179 @@ namespace Core
 	static boost::mutex COUNTER_MUTEX;
 	static boost::mutex PROCESS_MUTEX;
 	
-	class COrphan
+	/** Undoable View over the Test Pool of a Block being Assembled. Before a Transaction touches an Index, the prior state
+		is journaled, so a failed Transaction rolls back only what it changed instead of every candidate working on a copy of the whole Pool. **/
+	class CTestPoolView
 	{
 	public:
-		CTransaction* ptx;
-		set<uint512> setDependsOn;
-		double dPriority;
-
-		COrphan(CTransaction* ptxIn)
+		std::map<uint512, CTxIndex> mapTestPool;
+		
+		/** Record the state of hash before it is written. Recording the same hash twice is harmless, Rollback restores in reverse. **/
+		void Save(const uint512& hash)
 		{
-			ptx = ptxIn;
-			dPriority = 0;
+			std::map<uint512, CTxIndex>::iterator mi = mapTestPool.find(hash);
+			if (mi == mapTestPool.end())
+				vJournal.push_back(make_pair(hash, make_pair(false, CTxIndex())));
+			else
+				vJournal.push_back(make_pair(hash, make_pair(true, mi->second)));
 		}
-
-		void print() const
+		
+		void Rollback()
 		{
-			printf("COrphan(hash=%s, dPriority=%.1f)\n", ptx->GetHash().ToString().substr(0,10).c_str(), dPriority);
-			BOOST_FOREACH(uint512 hash, setDependsOn)
-				printf("   setDependsOn %s\n", hash.ToString().substr(0,10).c_str());
+			for (std::vector< std::pair< uint512, std::pair<bool, CTxIndex> > >::reverse_iterator it = vJournal.rbegin(); it != vJournal.rend(); ++it)
+			{
+				if (it->second.first)
+					mapTestPool[it->first] = it->second.second;
+				else
+					mapTestPool.erase(it->first);
+			}
+			
+			vJournal.clear();
 		}
+		
+		void Commit() { vJournal.clear(); }
+		
+	private:
+		std::vector< std::pair< uint512, std::pair<bool, CTxIndex> > > vJournal;
 	};
 	
+	/** Self-check of the Test Pool Journal: Rollback restores changed and removes added Entries, Commit keeps them. **/
+	bool SelfTestTestPoolView()
+	{
+		CTestPoolView view;
+		CTxIndex txindexOld(CDiskTxPos(1, 1, 1), 2), txindexNew(CDiskTxPos(2, 2, 2), 3);
+		
+		uint512 hashOld = 1, hashNew = 2;
+		view.mapTestPool[hashOld] = txindexOld;
+		
+		/** Change the same Entry twice so Rollback has to restore the first recorded State. **/
+		view.Save(hashOld);
+		view.mapTestPool[hashOld] = txindexNew;
+		view.Save(hashOld);
+		view.mapTestPool[hashOld].vSpent.clear();
+		view.Save(hashNew);
+		view.mapTestPool[hashNew] = txindexNew;
+		view.Rollback();
+		
+		if (view.mapTestPool.size() != 1 || view.mapTestPool[hashOld] != txindexOld)
+			return false;
+			
+		view.Save(hashNew);
+		view.mapTestPool[hashNew] = txindexNew;
+		view.Commit();
+		view.Rollback();
+		
+		return (view.mapTestPool.size() == 2 && view.mapTestPool[hashNew] == txindexNew);
+	}
+	
+	
+	/** Block Assembly Bookkeeping for nCandidates Transactions, most spending the Candidate before them, with the Test Pool
+		and Inputs copied per Candidate as AddTransactions used to, then journaled as it does now. One in twenty Candidates fails
+		to Connect and is undone. Scripts and Disk Reads cost the same both ways and are left out. Run with -bench=testpool. **/
+	void BenchTestPool(unsigned int nCandidates)
+	{
+		std::vector<CTransaction> vtx(nCandidates);
+		std::vector<uint512> vHashes(nCandidates);
+		for (unsigned int i = 0; i < nCandidates; i++)
+		{
+			vtx[i].vin.resize(1);
+			vtx[i].vin[0].prevout   = (i % 4 == 0) ? COutPoint(GetRand512(), 0) : COutPoint(vHashes[i - 1], 0);
+			vtx[i].vin[0].scriptSig = Wallet::CScript() << std::vector<unsigned char>(72, 1) << std::vector<unsigned char>(33, 2);
+			vtx[i].vout.resize(2);
+			for (unsigned int n = 0; n < vtx[i].vout.size(); n++)
+			{
+				vtx[i].vout[n].nValue = COIN;
+				vtx[i].vout[n].scriptPubKey = Wallet::CScript() << std::vector<unsigned char>(33, 3) << Wallet::OP_CHECKSIG;
+			}
+			
+			vHashes[i] = vtx[i].GetHash();
+		}
+		
+		int64 nTime[2];
+		unsigned int nBlockTx = 0;
+		for (int nMode = 0; nMode < 2; nMode++)
+		{
+			CTestPoolView view;
+			uint64 nBlockSize = 1000;
+			nBlockTx = 0;
+			
+			int64 nStart = GetTimeMillis();
+			for (unsigned int i = 0; i < nCandidates; i++)
+			{
+				unsigned int nTxSize = ::GetSerializeSize(vtx[i], SER_NETWORK, PROTOCOL_VERSION);
+				if (nBlockSize + nTxSize >= MAX_BLOCK_SIZE_GEN)
+					continue;
+					
+				const uint512& hashPrev = vtx[i].vin[0].prevout.hash;
+				MapPrevTx mapInputs;
+				mapInputs[hashPrev] = make_pair(CTxIndex(CDiskTxPos(1,1,1), 2), vtx[i > 0 ? i - 1 : 0]);
+				
+				bool fConnects = (i % 20 != 19);
+				if (nMode == 0)
+				{
+					std::map<uint512, CTxIndex> mapTestPoolTmp(view.mapTestPool);
+					MapPrevTx mapInputsCopy(mapInputs);
+					
+					CTxIndex& txindex = mapTestPoolTmp[hashPrev];
+					txindex = mapInputsCopy[hashPrev].first;
+					txindex.vSpent[0] = CDiskTxPos(1,1,1);
+					if (!fConnects)
+						continue;
+						
+					mapTestPoolTmp[vHashes[i]] = CTxIndex(CDiskTxPos(1,1,1), vtx[i].vout.size());
+					swap(view.mapTestPool, mapTestPoolTmp);
+				}
+				else
+				{
+					view.Save(hashPrev);
+					
+					CTxIndex& txindex = view.mapTestPool[hashPrev];
+					txindex = mapInputs[hashPrev].first;
+					txindex.vSpent[0] = CDiskTxPos(1,1,1);
+					if (!fConnects)
+					{
+						view.Rollback();
+						continue;
+					}
+					
+					view.mapTestPool[vHashes[i]] = CTxIndex(CDiskTxPos(1,1,1), vtx[i].vout.size());
+					view.Commit();
+				}
+				
+				nBlockSize += nTxSize;
+				nBlockTx++;
+			}
+			
+			nTime[nMode] = GetTimeMillis() - nStart;
+		}
+		
+		printf("bench testpool: %u of %u candidates fill a %u byte block, copying the test pool %" PRI64d " ms, journaled %" PRI64d " ms\n",
+			nBlockTx, nCandidates, MAX_BLOCK_SIZE_GEN, nTime[0], nTime[1]);
+	}
+	
+	/** Stop the Share Verifier Threads of the Mining LLP. **/
+	void StopMiningLLP() { LLP::cShareVerifier.Stop(); }
+	
 	/** Entry point for the Mining LLP. **/
 	void StartMiningLLP() { MINING_LLP = new LLP::Server<LLP::MiningLLP>(fTestNet ? TESTNET_MINING_LLP_PORT : NEXUS_MINING_LLP_PORT, GetArg("-mining_threads", 10), true, GetArg("-mining_cscore", 5), GetArg("-mining_rscore", 50), GetArg("-mining_timout", 60)); }
 	
 	
+	/** Collect the Share and Hashrate Counters of every Mining LLP Worker. **/
+	void GetMiningStats(std::vector<CMiningStats>& vStats)
+	{
+		vStats.clear();
+		
+		LOCK_GUARD(LLP::STATS_MUTEX);
+		for(std::set< boost::shared_ptr<LLP::WorkerStats> >::iterator it = LLP::setWorkerStats.begin(); it != LLP::setWorkerStats.end(); ++it)
+		{
+			CMiningStats stats;
+			(*it)->GetStats(stats);
+			
+			vStats.push_back(stats);
+		}
+	}
+	
+	
 	/** Entry Staking Function. **/
 	void StartStaking(Wallet::CWallet *pwallet) { CreateThread(StakeMinter, pwallet); }
 	
@@ -777,87 +1599,35 @@ namespace Core
 			LOCK2(cs_main, mempool.cs);
 			Wallet::CTxDB txdb("r");
 
-			// Priority order to process transactions
-			list<COrphan> vOrphan; // list memory doesn't move
-			map<uint512, vector<COrphan*> > mapDependers;
-			multimap<double, CTransaction*> mapPriority;
-			for (map<uint512, CTransaction>::iterator mi = mempool.mapTx.begin(); mi != mempool.mapTx.end(); ++mi)
+			/** The Memory Pool hands out its Entries already in Dependency Order, best Package first, so no Inputs are read from Disk to rank them. **/
+			vector<CTxMemPoolEntry*> vSelected;
+			mempool.SelectForBlock(vSelected, MAX_BLOCK_SIZE_GEN - 1000);
+
+			// Collect transactions into block
+			CTestPoolView view;
+			uint64 nBlockSize = 1000;
+			uint64 nBlockTx = 0;
+			int nBlockSigOps = 100;
+			BOOST_FOREACH(CTxMemPoolEntry* pentry, vSelected)
 			{
-				CTransaction& tx = (*mi).second;
+				CTransaction& tx = *pentry->ptx;
 				if (tx.IsCoinBase() || tx.IsCoinStake() || !tx.IsFinal())
 				{
 					if(fDebug)
-						printf("AddTransactions() : Transaction Is Coinbase/Coinstake or Not Final %s\n", tx.GetHash().ToString().substr(0, 10).c_str());
+						printf("AddTransactions() : Transaction Is Coinbase/Coinstake or Not Final %s\n", pentry->hash.ToString().substr(0, 10).c_str());
 						
 					continue;
 				}
-
-				COrphan* porphan = NULL;
-				double dPriority = 0;
-				BOOST_FOREACH(const CTxIn& txin, tx.vin)
-				{
-					// Read prev transaction
-					CTransaction txPrev;
-					CTxIndex txindex;
-					if (!txPrev.ReadFromDisk(txdb, txin.prevout, txindex))
-					{
-						// Has to wait for dependencies
-						if (!porphan)
-						{
-							// Use list for automatic deletion
-							vOrphan.push_back(COrphan(&tx));
-							porphan = &vOrphan.back();
-						}
-						
-						mapDependers[txin.prevout.hash].push_back(porphan);
-						porphan->setDependsOn.insert(txin.prevout.hash);
-						
-						continue;
-					}
-					int64 nValueIn = txPrev.vout[txin.prevout.n].nValue;
-
-					// Read block header
-					int nConf = txindex.GetDepthInMainChain();
-
-					dPriority += (double) nValueIn * nConf;
-
-					if (fDebug && GetBoolArg("-printpriority"))
-						printf("priority     nValueIn=%-12"PRI64d" nConf=%-5d dPriority=%-20.1f\n", nValueIn, nConf, dPriority);
-				}
-
-				// Priority is sum(valuein * age) / txsize
-				dPriority /= ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-
-				if (porphan)
-					porphan->dPriority = dPriority;
-				else
-					mapPriority.insert(make_pair(-dPriority, &(*mi).second));
-
+				
 				if (fDebug && GetBoolArg("-printpriority"))
-				{
-					printf("priority %-20.1f %s\n%s", dPriority, tx.GetHash().ToString().substr(0,10).c_str(), tx.ToString().c_str());
-					if (porphan)
-						porphan->print();
-				}
-			}
-
-			// Collect transactions into block
-			map<uint512, CTxIndex> mapTestPool;
-			uint64 nBlockSize = 1000;
-			uint64 nBlockTx = 0;
-			int nBlockSigOps = 100;
-			while (!mapPriority.empty())
-			{
-				// Take highest priority transaction off priority queue
-				CTransaction& tx = *(*mapPriority.begin()).second;
-				mapPriority.erase(mapPriority.begin());
+					printf("priority %-20.1f feerate %-12.4f %s\n", pentry->GetPriority(pindexPrev->nHeight), pentry->GetAncestorFeeRate(), pentry->hash.ToString().substr(0,10).c_str());
 
 				// Size limits
-				unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+				unsigned int nTxSize = pentry->nSize;
 				if (nBlockSize + nTxSize >= MAX_BLOCK_SIZE_GEN)
 				{
 					if(fDebug)
-						printf("AddTransactions() : Block Size Limits Reached on Transaction %s\n", tx.GetHash().ToString().substr(0, 10).c_str());
+						printf("AddTransactions() : Block Size Limits Reached on Transaction %s\n", pentry->hash.ToString().substr(0, 10).c_str());
 						
 					continue;
 				}
@@ -867,7 +1637,7 @@ namespace Core
 				if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS)
 				{
 					if(fDebug)
-						printf("AddTransactions() : Too Many Legacy Signature Operations %s\n", tx.GetHash().ToString().substr(0, 10).c_str());
+						printf("AddTransactions() : Too Many Legacy Signature Operations %s\n", pentry->hash.ToString().substr(0, 10).c_str());
 						
 					continue;
 				}
@@ -877,7 +1647,7 @@ namespace Core
 				if (tx.nTime > GetUnifiedTimestamp() + MAX_UNIFIED_DRIFT)
 				{
 					if(fDebug)
-						printf("AddTransactions() : Transaction Time Too Far in Future %s\n", tx.GetHash().ToString().substr(0, 10).c_str());
+						printf("AddTransactions() : Transaction Time Too Far in Future %s\n", pentry->hash.ToString().substr(0, 10).c_str());
 						
 					continue;
 				}
@@ -889,13 +1659,12 @@ namespace Core
 				
 				// Connecting shouldn't fail due to dependency on other memory pool transactions
 				// because we're already processing them in order of dependency
-				map<uint512, CTxIndex> mapTestPoolTmp(mapTestPool);
 				MapPrevTx mapInputs;
 				bool fInvalid;
-				if (!tx.FetchInputs(txdb, mapTestPoolTmp, false, true, mapInputs, fInvalid))
+				if (!tx.FetchInputs(txdb, view.mapTestPool, false, true, mapInputs, fInvalid))
 				{
 					if(fDebug)
-						printf("AddTransactions() : Failed to get Inputs %s\n", tx.GetHash().ToString().substr(0, 10).c_str());
+						printf("AddTransactions() : Failed to get Inputs %s\n", pentry->hash.ToString().substr(0, 10).c_str());
 						
 					vRemove.push_back(tx);
 					continue;
@@ -905,7 +1674,7 @@ namespace Core
 				if (nTxFees < nMinFee)
 				{
 					if(fDebug)
-						printf("AddTransactions() : Not Enough Fees %s\n", tx.GetHash().ToString().substr(0, 10).c_str());
+						printf("AddTransactions() : Not Enough Fees %s\n", pentry->hash.ToString().substr(0, 10).c_str());
 						
 					vRemove.push_back(tx);
 					continue;
@@ -915,23 +1684,28 @@ namespace Core
 				if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS)
 				{
 					if(fDebug)
-						printf("AddTransactions() : Too many P2SH Signature Operations %s\n", tx.GetHash().ToString().substr(0, 10).c_str());
+						printf("AddTransactions() : Too many P2SH Signature Operations %s\n", pentry->hash.ToString().substr(0, 10).c_str());
 						
 					vRemove.push_back(tx);
 					continue;
 				}
 
-				if (!tx.ConnectInputs(txdb, mapInputs, mapTestPoolTmp, CDiskTxPos(1,1,1), pindexPrev, false, true))
+				/** ConnectInputs writes back each Input as it goes, so journal them all in case a later one fails. **/
+				BOOST_FOREACH(const CTxIn& txin, tx.vin)
+					view.Save(txin.prevout.hash);
+					
+				if (!tx.ConnectInputs(txdb, mapInputs, view.mapTestPool, CDiskTxPos(1,1,1), pindexPrev, false, true))
 				{
 					if(fDebug)
-						printf("AddTransactions() : Failed to Connect Inputs %s\n", tx.GetHash().ToString().substr(0, 10).c_str());
+						printf("AddTransactions() : Failed to Connect Inputs %s\n", pentry->hash.ToString().substr(0, 10).c_str());
 						
+					view.Rollback();
 					vRemove.push_back(tx);
 					continue;
 				}
 				
-				mapTestPoolTmp[tx.GetHash()] = CTxIndex(CDiskTxPos(1,1,1), tx.vout.size());
-				swap(mapTestPool, mapTestPoolTmp);
+				view.mapTestPool[pentry->hash] = CTxIndex(CDiskTxPos(1,1,1), tx.vout.size());
+				view.Commit();
 
 				
 				// Added
@@ -940,22 +1714,6 @@ namespace Core
 				++nBlockTx;
 				nBlockSigOps += nTxSigOps;
 				nFees += nTxFees;
-
-				
-				// Add transactions that depend on this one to the priority queue
-				uint512 hash = tx.GetHash();
-				if (mapDependers.count(hash))
-				{
-					BOOST_FOREACH(COrphan* porphan, mapDependers[hash])
-					{
-						if (!porphan->setDependsOn.empty())
-						{
-							porphan->setDependsOn.erase(hash);
-							if (porphan->setDependsOn.empty())
-								mapPriority.insert(make_pair(-porphan->dPriority, porphan->ptx));
-						}
-					}
-				}
 			}
 
 			nLastBlockTx = nBlockTx;
@@ -967,7 +1725,7 @@ namespace Core
 		
 		//BOOST_FOREACH(CTransaction& tx, vRemove)
 		//{
-			//printf("AddTransactions() : removed invalid tx %s from mempool\n", tx.GetHash().ToString().substr(0, 10).c_str());
+			//printf("AddTransactions() : removed invalid tx %s from mempool\n", pentry->hash.ToString().substr(0, 10).c_str());
 			//mempool.remove(tx);
 		//}
 	}
@@ -1020,7 +1778,49 @@ namespace Core
 
 
 
-	/** Proof of Stake local CPU miner. Uses minimal resources. **/
+	/** Wakes the Stake Minter when the Best Chain or the Memory Pool changes. **/
+	static boost::mutex STAKE_MUTEX;
+	static boost::condition_variable STAKE_CONDITION;
+	static unsigned int nStakeTipEvents = 0, nStakeMempoolEvents = 0;
+	
+	/** Minimum Seconds between Rebuilding a Stake Block for new Memory Pool Transactions. **/
+	static const int STAKE_MEMPOOL_INTERVAL = 10;
+	
+	void NotifyStakeMinter(bool fNewTip)
+	{
+		{
+			boost::lock_guard<boost::mutex> lock(STAKE_MUTEX);
+			if(fNewTip)
+				nStakeTipEvents++;
+			else
+				nStakeMempoolEvents++;
+		}
+		
+		STAKE_CONDITION.notify_all();
+	}
+	
+	
+	/** Sleep the Stake Minter for up to nMilliseconds, returning early if a new notification arrives.
+		The counters passed in are the last ones seen by the caller and are updated on return. **/
+	static void WaitStakeMinter(unsigned int nMilliseconds, unsigned int& nTipEvents, unsigned int& nMempoolEvents)
+	{
+		boost::unique_lock<boost::mutex> lock(STAKE_MUTEX);
+		boost::system_time nTimeout = boost::get_system_time() + boost::posix_time::milliseconds(nMilliseconds);
+		
+		while(nTipEvents == nStakeTipEvents && nMempoolEvents == nStakeMempoolEvents && !fShutdown)
+			if(!STAKE_CONDITION.timed_wait(lock, nTimeout))
+				break;
+				
+		nTipEvents     = nStakeTipEvents;
+		nMempoolEvents = nStakeMempoolEvents;
+	}
+	
+	
+	/** Proof of Stake local CPU miner. Uses minimal resources. 
+	
+		The block is only rebuilt on a new best chain, or when the memory pool changed, and sleeps between
+		timestamp ticks until the efficiency threshold allows the next nonce. Trust and Block Weights are 
+		computed once per best block, and hashing only processes the nonce on top of a cached midstate. **/
 	void StakeMinter(void* parg)
 	{	
 		printf("Stake Minter Started\n");
@@ -1028,39 +1828,60 @@ namespace Core
 
 		// Each thread has its own key and counter
 		Wallet::CReserveKey reservekey(pwalletMain);
+		
+		/** Last Notifications seen by this Thread. **/
+		unsigned int nTipEvents = 0, nMempoolEvents = 0;
+		
+		/** Weights Cached for the Best Block and Trust Key they were computed for. **/
+		CBlockIndex* pindexWeights = NULL;
+		uint576 cKeyWeights;
+		uint64 nCoinAge = 0, nTrustAge = 0, nBlockAge = 0;
+		double nTrustWeight = 0.0, nBlockWeight = 0.0;
+		
+		/** Nonce carried over when the Block is rebuilt on the same Best Block. **/
+		CBlockIndex* pindexNonce = NULL;
+		uint64 nNonceCarry = 0;
 
 		loop
 		{
-			Sleep(100);
-			
 			if (fShutdown)
 				return;
 				
-			if (pwalletMain->IsLocked())
-				continue;
-
-			if (Net::vNodes.empty() || IsInitialBlockDownload())
+			if (pwalletMain->IsLocked() || Net::vNodes.empty() || IsInitialBlockDownload() ||
+				GetUnifiedTimestamp() < (fTestNet ? TESTNET_VERSION4_TIMELOCK : NETWORK_VERSION4_TIMELOCK))
+			{
+				WaitStakeMinter(1000, nTipEvents, nMempoolEvents);
 				continue;
+			}
+			
+			unsigned int nMempoolCreated = nMempoolEvents;
+			auto_ptr<CBlock> pblock(CreateNewBlock(reservekey, pwalletMain, 0));
+			if(!pblock.get())
+			{
+				dTrustWeight = 0;
+				dBlockWeight = 0;
 				
-			if (GetUnifiedTimestamp() < (fTestNet ? TESTNET_VERSION4_TIMELOCK : NETWORK_VERSION4_TIMELOCK))
+				WaitStakeMinter(5000, nTipEvents, nMempoolEvents);
 				continue;
-				
-			CBlock* pblock = CreateNewBlock(reservekey, pwalletMain, 0);
-			dTrustWeight = 0;
-			dBlockWeight = 0;
+			}
 			
-			if(!pblock)
-				continue;
+			CBlockIndex* pindex = mapBlockIndex[pblock->hashPrevBlock];
+			int64 nTimeCreated = GetUnifiedTimestamp();
 			
-			printf("Stake Minter : Created New Block %s\n", pblock->GetHash().ToString().substr(0, 20).c_str());
-			pblock->UpdateTime();
+			/** Keep the Attempts already made on this Best Block so a rebuild cannot reset the Threshold. **/
+			if(pindex == pindexNonce && nNonceCarry > pblock->nNonce)
+				pblock->nNonce = nNonceCarry;
 			
+			if(fDebug)
+				printf("Stake Minter : Created New Block %s\n", pblock->GetHash().ToString().substr(0, 20).c_str());
 			
 			vector< std::vector<unsigned char> > vKeys;
 			Wallet::TransactionType keyType;
 			if (!Wallet::Solver(pblock->vtx[0].vout[0].scriptPubKey, keyType, vKeys))
 			{
 				error("Stake Minter : Failed To Solve Trust Key Script.");
+				WaitStakeMinter(1000, nTipEvents, nMempoolEvents);
+				
 				continue;
 			}
 
@@ -1068,6 +1889,7 @@ namespace Core
 			if (keyType != Wallet::TX_PUBKEY)
 			{
 				error("Stake Minter : Trust Key must be of Public Key Type Created from Keypool.");
+				WaitStakeMinter(1000, nTipEvents, nMempoolEvents);
 				
 				continue;
 			}
@@ -1076,47 +1898,63 @@ namespace Core
 			uint576 cKey;
 			cKey.SetBytes(vKeys[0]);
 		
-			/** Determine Trust Age if the Trust Key Exists. **/
-			uint64 nCoinAge = 0, nTrustAge = 0, nBlockAge = 0;
-			double nTrustWeight = 0.0, nBlockWeight = 0.0;
-			if(cTrustPool.Exists(cKey))
+			/** Determine Trust Age if the Trust Key Exists. Only done once per Best Block. **/
+			if(pindex != pindexWeights || cKey != cKeyWeights)
 			{
-				nTrustAge = cTrustPool.Find(cKey).Age(mapBlockIndex[pblock->hashPrevBlock]->GetBlockTime());
-				nBlockAge = cTrustPool.Find(cKey).BlockAge(mapBlockIndex[pblock->hashPrevBlock]->GetBlockTime());
-				
-				/** Trust Weight Reaches Maximum at 30 day Limit. **/
-				nTrustWeight = min(17.5, (((16.5 * log(((2.0 * nTrustAge) / (60 * 60 * 24 * 28)) + 1.0)) / log(3))) + 1.0);
-				
-				/** Block Weight Reaches Maximum At Trust Key Expiration. **/
-				nBlockWeight = min(20.0, (((19.0 * log(((2.0 * nBlockAge) / (TRUST_KEY_EXPIRE)) + 1.0)) / log(3))) + 1.0);
-			}
-			else
-			{
-				/** Calculate the Average Coinstake Age. **/
-				Wallet::CTxDB txdb("r");
-				if(!pblock->vtx[0].GetCoinstakeAge(txdb, nCoinAge))
+				nCoinAge = 0, nTrustAge = 0, nBlockAge = 0;
+				nTrustWeight = 0.0, nBlockWeight = 0.0;
+				if(cTrustPool.Exists(cKey))
+				{
+					nTrustAge = cTrustPool.Find(cKey).Age(pindex->GetBlockTime());
+					nBlockAge = cTrustPool.Find(cKey).BlockAge(pindex->GetBlockTime());
+					
+					/** Trust Weight Reaches Maximum at 30 day Limit. **/
+					nTrustWeight = min(17.5, (((16.5 * log(((2.0 * nTrustAge) / (60 * 60 * 24 * 28)) + 1.0)) / log(3))) + 1.0);
+					
+					/** Block Weight Reaches Maximum At Trust Key Expiration. **/
+					nBlockWeight = min(20.0, (((19.0 * log(((2.0 * nBlockAge) / (TRUST_KEY_EXPIRE)) + 1.0)) / log(3))) + 1.0);
+				}
+				else
 				{
+					/** Calculate the Average Coinstake Age. **/
+					Wallet::CTxDB txdb("r");
+					if(!pblock->vtx[0].GetCoinstakeAge(txdb, nCoinAge))
+					{
+						txdb.Close();
+						error("Stake Minter : Failed to Get Coinstake Age.");
+						WaitStakeMinter(1000, nTipEvents, nMempoolEvents);
+						
+						continue;
+					}
 					txdb.Close();
-					error("Stake Minter : Failed to Get Coinstake Age.");
 					
-					continue;
+					/** Trust Weight For Genesis Transaction Reaches Maximum at 90 day Limit. **/
+					nTrustWeight = min(17.5, (((16.5 * log(((2.0 * nCoinAge) / (60 * 60 * 24 * 28 * 3)) + 1.0)) / log(3))) + 1.0);
 				}
-				txdb.Close();
 				
-				/** Trust Weight For Genesis Transaction Reaches Maximum at 90 day Limit. **/
-				nTrustWeight = min(17.5, (((16.5 * log(((2.0 * nCoinAge) / (60 * 60 * 24 * 28 * 3)) + 1.0)) / log(3))) + 1.0);
+				pindexWeights = pindex;
+				cKeyWeights   = cKey;
+				
+				printf("Stake Minter : Staking at Trust Weight %f | Block Weight %f | Coin Age %" PRIu64 " | Trust Age %" PRIu64 "| Block Age %" PRIu64 "\n", nTrustWeight, nBlockWeight, nCoinAge, nTrustAge, nBlockAge);
 			}
 			
 			/** Set the Reporting Variables for the Qt. **/
 			dTrustWeight = nTrustWeight;
 			dBlockWeight = nBlockWeight;
-				
-			printf("Stake Minter : Staking at Trust Weight %f | Block Weight %f | Coin Age %"PRIu64" | Trust Age %"PRIu64"| Block Age %"PRIu64"\n", nTrustWeight, nBlockWeight, nCoinAge, nTrustAge, nBlockAge);
-			CBlockIndex* pindex = pindexBest;
+			
+			/** The Required Efficiency and Target are constant for this Block. **/
+			double nRequired  = ((50.0 - nTrustWeight - nBlockWeight) * MAX_STAKE_WEIGHT) / std::min((int64)MAX_STAKE_WEIGHT, pblock->vtx[0].vout[0].nValue);
+			
+			CBigNum bnTarget;
+			bnTarget.SetCompact(pblock->nBits);
+			uint1024 hashTarget = bnTarget.getuint1024();
+			
+			/** Everything hashed before the Nonce stays the same for this Block. **/
+			SK1024Midstate midstate;
+			midstate.Set(BEGIN(pblock->nVersion), BEGIN(pblock->nNonce));
+			
 			while(true)
 			{
-				Sleep(120);
-				
 				if (fShutdown)
 					return;
 				
@@ -1126,34 +1964,43 @@ namespace Core
 				if (Net::vNodes.empty() || IsInitialBlockDownload())
 					break;
 				
-				if(pindex->GetBlockHash() != pindexBest->GetBlockHash())
+				if(pindex != pindexBest)
 				{
 					printf("Stake Minter : New Best Block\n");
 					break;
 				}
 				
+				/** Pick up new Memory Pool Transactions, though not on every single one of them. **/
+				if(nMempoolEvents != nMempoolCreated && !pblock->vtx[0].IsGenesis() && GetUnifiedTimestamp() >= nTimeCreated + STAKE_MEMPOOL_INTERVAL)
+				{
+					if(fDebug)
+						printf("Stake Minter : Memory Pool Updated\n");
+						
+					break;
+				}
+				
 				/** Update the block time for difficulty accuracy. **/
 				pblock->UpdateTime();
-				if(pblock->nTime == pblock->vtx[0].nTime)
-					continue;
 					
 				/** Calculate the Efficiency Threshold. **/
 				double nThreshold = (double)((pblock->nTime - pblock->vtx[0].nTime) * 100.0) / (pblock->nNonce + 1); //+1 to account for increment if that nNonce is chosen
-				double nRequired  = ((50.0 - nTrustWeight - nBlockWeight) * MAX_STAKE_WEIGHT) / std::min((int64)MAX_STAKE_WEIGHT, pblock->vtx[0].vout[0].nValue);
 					
-				/** Allow the Searching For Stake block if Below the Efficiency Threshold. **/
-				if(nThreshold < nRequired)
+				/** Allow the Searching For Stake block if Below the Efficiency Threshold. Otherwise sleep until the
+					timestamp reaches the Threshold, polling closer when it is within the next second. **/
+				if(pblock->nTime == pblock->vtx[0].nTime || nThreshold < nRequired)
+				{
+					double nSeconds = (nRequired * (pblock->nNonce + 1)) / 100.0 - (pblock->nTime - pblock->vtx[0].nTime);
+					WaitStakeMinter(nSeconds > 1.0 ? 1000 : 250, nTipEvents, nMempoolEvents);
+					
 					continue;
+				}
 				
 				pblock->nNonce ++;
-					
-				CBigNum hashTarget;
-				hashTarget.SetCompact(pblock->nBits);
 				
 				if(pblock->nNonce % (unsigned int)((nTrustWeight + nBlockWeight) * 5) == 0 && fDebug)
 					printf("Stake Minter : Below Threshold %f Required %f Incrementing nNonce %"PRIu64"\n", nThreshold, nRequired, pblock->nNonce);
-						
-				if (pblock->GetHash() < hashTarget.getuint1024())
+				
+				if (midstate.Hash(BEGIN(pblock->nNonce), END(pblock->nNonce)) < hashTarget)
 				{
 					
 					/** Sign the new Proof of Stake Block. **/
@@ -1180,12 +2027,15 @@ namespace Core
 					pblock->print();
 					
 					SetThreadPriority(THREAD_PRIORITY_NORMAL);
-					CheckWork(pblock, *pwalletMain, reservekey);
+					CheckWork(pblock.get(), *pwalletMain, reservekey);
 					SetThreadPriority(THREAD_PRIORITY_LOWEST);
 					
 					break;
 				}
 			}
+			
+			pindexNonce = pindex;
+			nNonceCarry = pblock->nNonce;
 		}
 	}
 
@@ -98,6 +98,134 @@ namespace Core
 		return nEvicted;
 	}
 
+	
+	/** Ancestor count is a Topological Order: a Parent always has fewer Ancestors than its Child. **/
+	static bool SortByAncestorCount(const CTxMemPoolEntry* a, const CTxMemPoolEntry* b)
+	{
+		return a->nCountWithAncestors < b->nCountWithAncestors;
+	}
+	
+	
+	/** Version of mempool.dat, and how many loaded Transactions are Verified together before they are Accepted. **/
+	static const int MEMPOOL_DUMP_VERSION = 1;
+	static const unsigned int MEMPOOL_LOAD_BATCH = 1000;
+	
+	
+	bool DumpMempool()
+	{
+		int64 nStart = GetTimeMillis();
+		
+		/** Parents are written before their Children so every Transaction can find its Inputs when Loaded again. **/
+		vector<CTransaction> vtx;
+		{
+			LOCK(mempool.cs);
+			vector<CTxMemPoolEntry*> vEntries;
+			for (map<uint512, CTxMemPoolEntry>::iterator mi = mempool.mapEntry.begin(); mi != mempool.mapEntry.end(); ++mi)
+				vEntries.push_back(&mi->second);
+				
+			sort(vEntries.begin(), vEntries.end(), SortByAncestorCount);
+			
+			vtx.reserve(vEntries.size());
+			BOOST_FOREACH(CTxMemPoolEntry* pentry, vEntries)
+				vtx.push_back(*pentry->ptx);
+		}
+		
+		boost::filesystem::path pathTmp = GetDataDir() / "mempool.dat.new";
+		{
+			CAutoFile fileout = CAutoFile(fopen(pathTmp.string().c_str(), "wb"), SER_DISK, DATABASE_VERSION);
+			if (!fileout)
+				return error("DumpMempool() : cannot open %s", pathTmp.string().c_str());
+				
+			try
+			{
+				fileout << MEMPOOL_DUMP_VERSION << vtx;
+			}
+			catch (std::exception &e)
+			{
+				return error("DumpMempool() : serialize failed %s", e.what());
+			}
+		}
+		
+		boost::filesystem::rename(pathTmp, GetDataDir() / "mempool.dat");
+		printf("DumpMempool() : %u transactions in %" PRI64d "ms\n", vtx.size(), GetTimeMillis() - nStart);
+		
+		return true;
+	}
+	
+	
+	/** Verify the Signatures of every nStep'th Transaction in [nBegin, nEnd). Results land in the Signature Cache, so the serial accept afterwards only checks them once. **/
+	static void PreVerifyTransactions(vector<CTransaction>* pvtx, unsigned int nBegin, unsigned int nStep, unsigned int nEnd)
+	{
+		Wallet::CTxDB txdb("r");
+		for (unsigned int i = nBegin; i < nEnd && !fShutdown; i += nStep)
+		{
+			CTransaction& tx = (*pvtx)[i];
+			
+			/** Parents in the same Batch are not in the Pool yet. Those are left to accept. **/
+			MapPrevTx mapInputs;
+			map<uint512, CTxIndex> mapUnused;
+			bool fInvalid = false;
+			if (!tx.FetchInputs(txdb, mapUnused, false, false, mapInputs, fInvalid))
+				continue;
+				
+			for (unsigned int n = 0; n < tx.vin.size(); n++)
+			{
+				MapPrevTx::iterator mi = mapInputs.find(tx.vin[n].prevout.hash);
+				if (mi != mapInputs.end())
+					Wallet::VerifySignature(mi->second.second, tx, n, 0);
+			}
+		}
+	}
+	
+	
+	bool LoadMempool()
+	{
+		int64 nStart = GetTimeMillis();
+		
+		boost::filesystem::path pathMempool = GetDataDir() / "mempool.dat";
+		vector<CTransaction> vtx;
+		{
+			CAutoFile filein = CAutoFile(fopen(pathMempool.string().c_str(), "rb"), SER_DISK, DATABASE_VERSION);
+			if (!filein)
+				return false;
+				
+			try
+			{
+				int nVersion = 0;
+				filein >> nVersion;
+				if (nVersion != MEMPOOL_DUMP_VERSION)
+					return error("LoadMempool() : unknown version %d", nVersion);
+					
+				filein >> vtx;
+			}
+			catch (std::exception &e)
+			{
+				return error("LoadMempool() : deserialize failed %s", e.what());
+			}
+		}
+		
+		/** Signatures are Verified on every Core a Batch at a time, then the Batch is Accepted in File Order under cs_main. **/
+		unsigned int nThreads = max(1u, boost::thread::hardware_concurrency()), nAccepted = 0;
+		for (unsigned int nBatch = 0; nBatch < vtx.size() && !fShutdown; nBatch += MEMPOOL_LOAD_BATCH)
+		{
+			unsigned int nEnd = min((unsigned int)vtx.size(), nBatch + MEMPOOL_LOAD_BATCH);
+			
+			boost::thread_group threads;
+			for (unsigned int nThread = 0; nThread < nThreads; nThread++)
+				threads.create_thread(boost::bind(&PreVerifyTransactions, &vtx, nBatch + nThread, nThreads, nEnd));
+			threads.join_all();
+			
+			LOCK(cs_main);
+			Wallet::CTxDB txdb("r");
+			for (unsigned int i = nBatch; i < nEnd; i++)
+				if (vtx[i].AcceptToMemoryPool(txdb, true))
+					nAccepted++;
+		}
+		
+		printf("LoadMempool() : accepted %u of %u transactions in %" PRI64d "ms\n", nAccepted, vtx.size(), GetTimeMillis() - nStart);
+		return true;
+	}
+
 
 
 
@@ -355,6 +483,40 @@ namespace Core
 		return true;
 	}
 
+	/** Fee and Main Chain Input Value of a Transaction for the Pool Bookkeeping. Finding the Blocks of the Inputs takes cs_main,
+		so this runs before the Pool Lock is taken, keeping the Lock Order of cs_main before mempool.cs. **/
+	static void GetPoolInputValues(const CTransaction& tx, const MapPrevTx& mapInputs, int64& nFee, int64& nChainValueIn, double& dChainValueHeight)
+	{
+		int64 nValueIn = 0;
+		bool fResolved = !mapInputs.empty();
+		
+		nChainValueIn = 0;
+		dChainValueHeight = 0;
+		BOOST_FOREACH(const CTxIn& txin, tx.vin)
+		{
+			MapPrevTx::const_iterator it = mapInputs.find(txin.prevout.hash);
+			if (it == mapInputs.end() || txin.prevout.n >= it->second.second.vout.size())
+			{
+				fResolved = false;
+				continue;
+			}
+				
+			int64 nValue = it->second.second.vout[txin.prevout.n].nValue;
+			nValueIn += nValue;
+			
+			CBlockIndex* pindex = GetBlockIndexAt(it->second.first.pos);
+			if (pindex && pindex->IsInMainChain())
+			{
+				nChainValueIn     += nValue;
+				dChainValueHeight += (double)nValue * pindex->nHeight;
+			}
+		}
+		
+		/** The Fee is only known when every Input was found. Otherwise the Transaction counts as paying none, so it never lifts its Package. **/
+		nFee = fResolved ? max(nValueIn - tx.GetValueOut(), (int64)0) : 0;
+	}
+	
+	
 	bool CTxMemPool::accept(Wallet::CTxDB& txdb, CTransaction &tx, bool fCheckInputs,
 							bool* pfMissingInputs)
 	{
@@ -419,11 +581,11 @@ namespace Core
 			}
 		}
 
+		MapPrevTx mapInputs;
+		map<uint512, CTxIndex> mapUnused;
+		bool fInvalid = false;
 		if (fCheckInputs)
 		{
-			MapPrevTx mapInputs;
-			map<uint512, CTxIndex> mapUnused;
-			bool fInvalid = false;
 			if (!tx.FetchInputs(txdb, mapUnused, false, false, mapInputs, fInvalid))
 			{
 				if (fInvalid)
@@ -480,6 +642,14 @@ namespace Core
 				return error("CTxMemPool::accept() : ConnectInputs failed %s", hash.ToString().substr(0,10).c_str());
 			}
 		}
+		
+		/** Transactions returned from a Disconnected Block skip the checks, but still want their Inputs for the Pool Bookkeeping. **/
+		else if (!tx.FetchInputs(txdb, mapUnused, false, false, mapInputs, fInvalid))
+			mapInputs.clear();
+			
+		int64 nPoolFee, nChainValueIn;
+		double dChainValueHeight;
+		GetPoolInputValues(tx, mapInputs, nPoolFee, nChainValueIn, dChainValueHeight);
 
 		// Store transaction in memory
 		{
@@ -489,8 +659,13 @@ namespace Core
 				printf("CTxMemPool::accept() : replacing tx %s with new version\n", ptxOld->GetHash().ToString().c_str());
 				remove(*ptxOld);
 			}
-			addUnchecked(tx);
+			AddEntry(tx, nPoolFee, nChainValueIn, dChainValueHeight);
+			
+			TrimToSize(GetArg("-maxmempool", 300) * 1000000);
+			if (!mapTx.count(hash))
+				return error("CTxMemPool::accept() : mempool full %s", hash.ToString().substr(0,10).c_str());
 		}
+		NotifyStakeMinter(false);
 
 		///// are we sure this is ok when loading transactions or restoring block txes
 		// If updated, erase old tx from wallet
@@ -506,21 +681,106 @@ namespace Core
 		return mempool.accept(txdb, *this, fCheckInputs, pfMissingInputs);
 	}
 
-	bool CTxMemPool::addUnchecked(CTransaction &tx)
+	/** Heap held by a Pool Transaction and its Indexes. Tree Nodes count as their Payload plus three Links and a Color Word. **/
+	static uint64 MemPoolUsage(const CTransaction& tx)
+	{
+		const uint64 nNode = 4 * sizeof(void*);
+		
+		uint64 nUsage = tx.vin.capacity() * sizeof(CTxIn) + tx.vout.capacity() * sizeof(CTxOut);
+		BOOST_FOREACH(const CTxIn& txin, tx.vin)
+			nUsage += txin.scriptSig.capacity();
+		BOOST_FOREACH(const CTxOut& txout, tx.vout)
+			nUsage += txout.scriptPubKey.capacity();
+			
+		/** mapTx, mapEntry, setByScore and setByTime Nodes, then the mapNextTx Node and up to two Dependency Links per Input. **/
+		nUsage += nNode + sizeof(uint512) + sizeof(CTransaction);
+		nUsage += nNode + sizeof(uint512) + sizeof(CTxMemPoolEntry);
+		nUsage += nNode + sizeof(CTxMemPoolEntry*);
+		nUsage += nNode + sizeof(std::pair<int64, uint512>);
+		nUsage += tx.vin.size() * (nNode + sizeof(COutPoint) + sizeof(CInPoint) + 2 * (nNode + sizeof(CTxMemPoolEntry*)));
+		
+		return nUsage;
+	}
+	
+	
+	bool CTxMemPool::addUnchecked(CTransaction &tx, const MapPrevTx& mapInputs)
 	{
 		printf("addUnchecked(): size %lu\n",  mapTx.size());
+		
+		int64 nFee, nChainValueIn;
+		double dChainValueHeight;
+		GetPoolInputValues(tx, mapInputs, nFee, nChainValueIn, dChainValueHeight);
+		
 		// Add to memory pool without checking anything.  Don't call this directly,
 		// call CTxMemPool::accept to properly check the transaction first.
 		{
 			LOCK(cs);
-			uint512 hash = tx.GetHash();
-			mapTx[hash] = tx;
-			for (unsigned int i = 0; i < tx.vin.size(); i++)
-				mapNextTx[tx.vin[i].prevout] = CInPoint(&mapTx[hash], i);
-
+			AddEntry(tx, nFee, nChainValueIn, dChainValueHeight);
 		}
+		NotifyStakeMinter(false);
+		
 		return true;
 	}
+	
+	
+	void CTxMemPool::AddEntry(CTransaction &tx, int64 nFee, int64 nChainValueIn, double dChainValueHeight)
+	{
+		uint512 hash = tx.GetHash();
+		CTransaction* ptx = &(mapTx[hash] = tx);
+		for (unsigned int i = 0; i < tx.vin.size(); i++)
+			mapNextTx[tx.vin[i].prevout] = CInPoint(ptx, i);
+			
+		CTxMemPoolEntry& entry = mapEntry[hash];
+		entry.ptx               = ptx;
+		entry.hash              = hash;
+		entry.nSize             = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+		entry.nTime             = GetUnifiedTimestamp();
+		entry.nFee              = nFee;
+		entry.nChainValueIn     = nChainValueIn;
+		entry.dChainValueHeight = dChainValueHeight;
+		entry.dEntryPriority    = entry.GetPriority(nBestHeight);
+		entry.nSizeWithAncestors = entry.nSize;
+		entry.nFeesWithAncestors = entry.nFee;
+		entry.nUsage             = MemPoolUsage(tx);
+		nTotalUsage             += entry.nUsage;
+		
+		/** Link to the Parents in the Pool, so Dependencies never have to be looked up again. **/
+		BOOST_FOREACH(const CTxIn& txin, tx.vin)
+		{
+			map<uint512, CTxMemPoolEntry>::iterator mi = mapEntry.find(txin.prevout.hash);
+			if (mi != mapEntry.end())
+			{
+				entry.setParents.insert(&mi->second);
+				mi->second.setChildren.insert(&entry);
+			}
+		}
+		
+		/** Children can already be in the Pool when the Transactions of a Disconnected Block return to it. **/
+		for (unsigned int n = 0; n < tx.vout.size(); n++)
+		{
+			map<COutPoint, CInPoint>::iterator it = mapNextTx.find(COutPoint(hash, n));
+			if (it == mapNextTx.end())
+				continue;
+				
+			map<uint512, CTxMemPoolEntry>::iterator mi = mapEntry.find(it->second.ptx->GetHash());
+			if (mi != mapEntry.end())
+			{
+				entry.setChildren.insert(&mi->second);
+				mi->second.setParents.insert(&entry);
+			}
+		}
+		
+		UpdateAncestorState(&entry);
+		if (!entry.setChildren.empty())
+		{
+			set<CTxMemPoolEntry*> setDescendants;
+			CalculateDescendants(&entry, setDescendants);
+			BOOST_FOREACH(CTxMemPoolEntry* pdescendant, setDescendants)
+				UpdateAncestorState(pdescendant);
+		}
+		
+		setByTime.insert(make_pair(entry.nTime, hash));
+	}
 
 
 	bool CTxMemPool::remove(CTransaction &tx)
@@ -531,12 +791,239 @@ namespace Core
 			uint512 hash = tx.GetHash();
 			if (mapTx.count(hash))
 			{
+				map<uint512, CTxMemPoolEntry>::iterator mi = mapEntry.find(hash);
+				if (mi != mapEntry.end())
+				{
+					CTxMemPoolEntry* pentry = &mi->second;
+					setByScore.erase(pentry);
+					setByTime.erase(make_pair(pentry->nTime, hash));
+					
+					/** Every Descendant loses this Transaction from its Ancestor Package. **/
+					set<CTxMemPoolEntry*> setDescendants;
+					CalculateDescendants(pentry, setDescendants);
+					BOOST_FOREACH(CTxMemPoolEntry* pdescendant, setDescendants)
+					{
+						setByScore.erase(pdescendant);
+						pdescendant->nCountWithAncestors--;
+						pdescendant->nSizeWithAncestors -= pentry->nSize;
+						pdescendant->nFeesWithAncestors -= pentry->nFee;
+						setByScore.insert(pdescendant);
+					}
+					
+					nTotalUsage -= pentry->nUsage;
+					
+					BOOST_FOREACH(CTxMemPoolEntry* pparent, pentry->setParents)
+						pparent->setChildren.erase(pentry);
+					BOOST_FOREACH(CTxMemPoolEntry* pchild, pentry->setChildren)
+						pchild->setParents.erase(pentry);
+						
+					mapEntry.erase(mi);
+				}
+				
 				BOOST_FOREACH(const CTxIn& txin, tx.vin)
 					mapNextTx.erase(txin.prevout);
 				mapTx.erase(hash);
+				
+				NotifyStakeMinter(false);
+			}
+		}
+		return true;
+	}
+	
+	
+	void CTxMemPool::CalculateAncestors(CTxMemPoolEntry* pentry, set<CTxMemPoolEntry*>& setAncestors)
+	{
+		vector<CTxMemPoolEntry*> vStack(pentry->setParents.begin(), pentry->setParents.end());
+		while (!vStack.empty())
+		{
+			CTxMemPoolEntry* pancestor = vStack.back();
+			vStack.pop_back();
+			
+			if (setAncestors.insert(pancestor).second)
+				vStack.insert(vStack.end(), pancestor->setParents.begin(), pancestor->setParents.end());
+		}
+	}
+	
+	
+	void CTxMemPool::CalculateDescendants(CTxMemPoolEntry* pentry, set<CTxMemPoolEntry*>& setDescendants)
+	{
+		vector<CTxMemPoolEntry*> vStack(pentry->setChildren.begin(), pentry->setChildren.end());
+		while (!vStack.empty())
+		{
+			CTxMemPoolEntry* pdescendant = vStack.back();
+			vStack.pop_back();
+			
+			if (setDescendants.insert(pdescendant).second)
+				vStack.insert(vStack.end(), pdescendant->setChildren.begin(), pdescendant->setChildren.end());
+		}
+	}
+	
+	
+	void CTxMemPool::UpdateAncestorState(CTxMemPoolEntry* pentry)
+	{
+		/** The Score is the Key of setByScore, so the Entry has to leave the Index while it changes. **/
+		setByScore.erase(pentry);
+		
+		set<CTxMemPoolEntry*> setAncestors;
+		CalculateAncestors(pentry, setAncestors);
+		
+		pentry->nCountWithAncestors = 1 + setAncestors.size();
+		pentry->nSizeWithAncestors  = pentry->nSize;
+		pentry->nFeesWithAncestors  = pentry->nFee;
+		BOOST_FOREACH(CTxMemPoolEntry* pancestor, setAncestors)
+		{
+			pentry->nSizeWithAncestors += pancestor->nSize;
+			pentry->nFeesWithAncestors += pancestor->nFee;
+		}
+		
+		setByScore.insert(pentry);
+	}
+	
+	
+	void CTxMemPool::SelectForBlock(vector<CTxMemPoolEntry*>& vSelected, uint64 nMaxSize)
+	{
+		LOCK(cs);
+		
+		set<CTxMemPoolEntry*> setSelected;
+		uint64 nTotalSize = 0;
+		unsigned int nFailures = 0;
+		
+		/** Stop once the Block is full, or a run of Packages did not fit, so the work follows the Block Size and not the Pool Size. **/
+		for (set<CTxMemPoolEntry*, CTxMemPoolScoreCompare>::iterator it = setByScore.begin(); it != setByScore.end() && nTotalSize < nMaxSize && nFailures < 100; ++it)
+		{
+			CTxMemPoolEntry* pentry = *it;
+			if (setSelected.count(pentry))
+				continue;
+				
+			/** Ancestors not yet Selected have to go in first, so the whole Package has to fit. **/
+			set<CTxMemPoolEntry*> setAncestors;
+			CalculateAncestors(pentry, setAncestors);
+			
+			vector<CTxMemPoolEntry*> vPackage;
+			uint64 nPackageSize = pentry->nSize;
+			BOOST_FOREACH(CTxMemPoolEntry* pancestor, setAncestors)
+			{
+				if (setSelected.count(pancestor))
+					continue;
+					
+				vPackage.push_back(pancestor);
+				nPackageSize += pancestor->nSize;
+			}
+			
+			if (nTotalSize + nPackageSize > nMaxSize)
+			{
+				nFailures++;
+				continue;
+			}
+			
+			vPackage.push_back(pentry);
+			sort(vPackage.begin(), vPackage.end(), SortByAncestorCount);
+			BOOST_FOREACH(CTxMemPoolEntry* pselected, vPackage)
+			{
+				setSelected.insert(pselected);
+				vSelected.push_back(pselected);
+			}
+			
+			nTotalSize += nPackageSize;
+		}
+	}
 
+	
+	unsigned int CTxMemPool::TrimToSize(uint64 nMaxUsage)
+	{
+		LOCK(cs);
+		
+		unsigned int nEvicted = 0;
+		while (nTotalUsage > nMaxUsage && !setByScore.empty())
+		{
+			/** The worst Ancestor Package sorts last. Its Descendants cannot be mined without it, so they leave with it. **/
+			CTxMemPoolEntry* pentry = *setByScore.rbegin();
+			
+			set<CTxMemPoolEntry*> setDescendants;
+			CalculateDescendants(pentry, setDescendants);
+			
+			vector<uint512> vRemove(1, pentry->hash);
+			BOOST_FOREACH(CTxMemPoolEntry* pdescendant, setDescendants)
+				vRemove.push_back(pdescendant->hash);
+				
+			BOOST_FOREACH(const uint512& hash, vRemove)
+			{
+				map<uint512, CTransaction>::iterator mi = mapTx.find(hash);
+				if (mi == mapTx.end())
+					continue;
+					
+				remove(mi->second);
+				nEvicted++;
+			}
+		}
+		
+		if (nEvicted > 0)
+			printf("CTxMemPool::TrimToSize() : evicted %u transactions, %" PRI64u " bytes in use\n", nEvicted, nTotalUsage);
+			
+		return nEvicted;
+	}
+	
+	
+	bool CTxMemPool::SelfTest()
+	{
+		/** A Parent paying almost nothing, its Child paying a lot, and an unrelated Transaction between the two Fee Rates. **/
+		CTransaction txFunding;
+		txFunding.vout.resize(2);
+		
+		CTransaction txParent, txChild, txOther;
+		txParent.vin.resize(1);
+		txParent.vin[0].prevout = COutPoint(txFunding.GetHash(), 0);
+		txParent.vout.resize(1);
+		
+		txOther.vin.resize(1);
+		txOther.vin[0].prevout = COutPoint(txFunding.GetHash(), 1);
+		txOther.vout.resize(1);
+		
+		txChild.vin.resize(1);
+		txChild.vin[0].prevout = COutPoint(txParent.GetHash(), 0);
+		txChild.vout.resize(1);
+		
+		/** The Child first is the order Transactions of a Disconnected Block return in. Both orders have to link up the same.
+			Entries go in with their Fees already known, so no Inputs are resolved and no Chain Lock is taken. **/
+		for (int nOrder = 0; nOrder < 2; nOrder++)
+		{
+			CTxMemPool pool;
+			LOCK(pool.cs);
+			if (nOrder == 0)
+			{
+				pool.AddEntry(txParent, 10, 0, 0);
+				pool.AddEntry(txChild, 99990, 0, 0);
 			}
+			else
+			{
+				pool.AddEntry(txChild, 99990, 0, 0);
+				pool.AddEntry(txParent, 10, 0, 0);
+			}
+			pool.AddEntry(txOther, 1000, 0, 0);
+			
+			CTxMemPoolEntry* pParent = &pool.mapEntry[txParent.GetHash()];
+			CTxMemPoolEntry* pChild  = &pool.mapEntry[txChild.GetHash()];
+			CTxMemPoolEntry* pOther  = &pool.mapEntry[txOther.GetHash()];
+			if (pChild->nCountWithAncestors != 2 || pChild->nFeesWithAncestors != pParent->nFee + pChild->nFee ||
+				pChild->nSizeWithAncestors != (uint64)pParent->nSize + pChild->nSize || pOther->nCountWithAncestors != 1)
+				return false;
+				
+			/** The Child lifts its Parent above the unrelated Transaction, and the Parent goes in first. **/
+			std::vector<CTxMemPoolEntry*> vSelected;
+			pool.SelectForBlock(vSelected, std::numeric_limits<uint64>::max());
+			if (vSelected.size() != 3 || vSelected[0] != pParent || vSelected[1] != pChild || vSelected[2] != pOther)
+				return false;
+				
+			/** Trimming drops the worst Package, the Parent alone, and takes its Child with it. **/
+			uint64 nUsageOther = pOther->nUsage;
+			if (pool.TrimToSize(pool.DynamicUsage() - 1) != 2)
+				return false;
+				
+			if (pool.size() != 1 || pool.mapEntry.size() != 1 || pool.setByScore.size() != 1 || pool.setByTime.size() != 1 ||
+				!pool.exists(txOther.GetHash()) || pool.DynamicUsage() != nUsageOther)
+				return false;
 		}
+		
 		return true;
 	}
 
@@ -549,6 +1036,21 @@ namespace Core
 	{
 		if (hashBlock == 0 || nIndex == -1)
 			return 0;
+			
+		/** Reuse the last answer if the best chain and the block this claims to be in have not changed. **/
+		if (nDepthGeneration == nBestChainGeneration && nDepthIndex == nIndex && hashDepthBlock == hashBlock)
+		{
+			if (pindexDepthCached)
+				pindexRet = pindexDepthCached;
+				
+			return nDepthCached;
+		}
+		
+		nDepthGeneration  = nBestChainGeneration;
+		hashDepthBlock    = hashBlock;
+		nDepthIndex       = nIndex;
+		nDepthCached      = 0;
+		pindexDepthCached = NULL;
 
 		// Find the block it claims to be in
 		map<uint1024, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
@@ -566,8 +1068,46 @@ namespace Core
 			fMerkleVerified = true;
 		}
 
+		nDepthCached      = pindexBest->nHeight - pindex->nHeight + 1;
+		pindexDepthCached = pindex;
+		
 		pindexRet = pindex;
-		return pindexBest->nHeight - pindex->nHeight + 1;
+		return nDepthCached;
+	}
+
+
+	/** Self-check of the Depth Cache on the Coinbase of the Best Block. A repeated Query is answered from the Cache,
+		a new Best Chain Generation or Block Location recomputes it. **/
+	bool SelfTestDepthCache()
+	{
+		CBlock block;
+		if (!pindexBest || !block.ReadFromDisk(pindexBest))
+			return false;
+			
+		CMerkleTx tx(block.vtx[0]);
+		tx.SetMerkleBranch(&block);
+		
+		CBlockIndex* pindex = NULL;
+		if (tx.GetDepthInMainChain(pindex) != 1 || pindex != pindexBest)
+			return false;
+			
+		/** Only an Answer from the Cache can come back as the poisoned Value. **/
+		tx.nDepthCached = -1;
+		if (tx.GetDepthInMainChain() != -1)
+			return false;
+			
+		tx.nIndex++;
+		if (tx.GetDepthInMainChain() != 1)
+			return false;
+			
+		tx.nIndex--;
+		tx.GetDepthInMainChain();
+		
+		tx.nDepthCached = -1;
+		nBestChainGeneration++;
+		
+		pindex = NULL;
+		return (tx.GetDepthInMainChain(pindex) == 1 && pindex == pindexBest);
 	}
 
 
@@ -601,15 +1141,8 @@ namespace Core
 
 	int CTxIndex::GetDepthInMainChain() const
 	{
-		// Read block header
-		CBlock block;
-		if (!block.ReadFromDisk(pos.nFile, pos.nBlockPos, false))
-			return 0;
 		// Find the block in the index
-		map<uint1024, CBlockIndex*>::iterator mi = mapBlockIndex.find(block.GetHash());
-		if (mi == mapBlockIndex.end())
-			return 0;
-		CBlockIndex* pindex = (*mi).second;
+		CBlockIndex* pindex = GetBlockIndexAt(pos);
 		if (!pindex || !pindex->IsInMainChain())
 			return 0;
 		return 1 + nBestHeight - pindex->nHeight;
@@ -787,7 +1320,7 @@ namespace Core
 		return nSigOps;
 	}
 
-	bool CTransaction::ConnectInputs(Wallet::CTxDB& txdb, MapPrevTx inputs,
+	bool CTransaction::ConnectInputs(Wallet::CTxDB& txdb, MapPrevTx& inputs,
 									 map<uint512, CTxIndex>& mapTestPool, const CDiskTxPos& posThisTx,
 									 const CBlockIndex* pindexBlock, bool fBlock, bool fMiner)
 	{
@@ -860,7 +1393,7 @@ namespace Core
 			if (IsCoinStake())
 			{
 				int64 nInterest;
-				GetCoinstakeInterest(txdb, nInterest);
+				GetCoinstakeInterest(inputs, nInterest);
 				
 				printf("ConnectInputs() : %f Value Out, %f Interest, %f Expected\n", (double)vout[0].nValue / COIN, (double)nInterest / COIN, (double)(nInterest + nValueIn) / COIN);
 				if (vout[0].nValue != (nInterest + nValueIn))
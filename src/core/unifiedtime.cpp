@@ -169,7 +169,7 @@ void ThreadTimeRegulator(void* parg)
 				SERVER.ReadPacket();
 				if(SERVER.PacketComplete())
 				{
-					LLP::Packet PACKET = SERVER.NewPacket();
+					const LLP::Packet& PACKET = SERVER.NewPacket();
 					
 					/** Add a New Sample each Time Packet Arrives. **/
 					if(PACKET.HEADER == SERVER.TIME_OFFSET)
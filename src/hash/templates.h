@@ -217,4 +217,41 @@ inline uint1024 SK1024(const T1 pbegin, const T1 pend)
     return keccak;
 }
 
+/** Skein-1024 state after the fixed leading bytes of a message. Messages that only differ in their
+	trailing bytes (such as a block header's nonce) are hashed without processing the prefix again. **/
+class SK1024Midstate
+{
+	Skein1024_Ctxt_t ctx;
+	
+public:
+
+	/** Absorb the constant prefix of the message. **/
+	template<typename T1>
+	void Set(const T1 pbegin, const T1 pend)
+	{
+		Skein1024_Init(&ctx, 1024);
+		if(pbegin != pend)
+			Skein1024_Update(&ctx, (unsigned char*)&pbegin[0], (pend - pbegin) * sizeof(pbegin[0]));
+	}
+	
+	/** Hash the prefix followed by the given suffix. Same result as SK1024 over the whole message. **/
+	template<typename T1>
+	uint1024 Hash(const T1 pbegin, const T1 pend) const
+	{
+		uint1024 skein;
+		Skein1024_Ctxt_t ctxCopy = ctx;
+		if(pbegin != pend)
+			Skein1024_Update(&ctxCopy, (unsigned char*)&pbegin[0], (pend - pbegin) * sizeof(pbegin[0]));
+		Skein1024_Final(&ctxCopy, (unsigned char *)&skein);
+		
+		uint1024 keccak;
+		Keccak_HashInstance ctx_keccak;
+		Keccak_HashInitialize(&ctx_keccak, 576, 1024, 1024, 0x05);
+		Keccak_HashUpdate(&ctx_keccak, (unsigned char *)&skein, 1024);
+		Keccak_HashFinal(&ctx_keccak, (unsigned char *)&keccak);
+		
+		return keccak;
+	}
+};
+
 #endif
\ No newline at end of file
@@ -16,6 +16,8 @@
 #include <vector>
 #include <stdint.h>
 
+#include <boost/static_assert.hpp>
+
 /** Linux Specific Work Around (For Now). **/
 #if defined(MAC_OSX) || defined(WIN32)
 typedef int64_t int64;
@@ -28,19 +30,33 @@ typedef unsigned long long  uint64;
 
 /** Base class without constructors for uint256, uint512, uint576, uint1024.
  * This makes the compiler let u use it in a union.
+ *
+ * Storage stays as 32 bit limbs so the serialized and GetBytes layouts are unchanged,
+ * but comparison, addition, subtraction and shifts work on 64 bit words (limbs 2n and 2n+1),
+ * halving the loop count. Every width in use is a multiple of 64 bits.
  */
 template<unsigned int BITS>
 class base_uint
 {
 protected:
-    enum { WIDTH=BITS/32 };
+    enum { WIDTH=BITS/32, WORDS=BITS/64 };
     unsigned int pn[WIDTH];
+    
+    /** The 64 bit word loops would skip the last limb of any other width. **/
+    BOOST_STATIC_ASSERT(BITS % 64 == 0);
+    
+    void Set64(int n, uint64 b)
+    {
+        pn[2*n]   = (unsigned int)b;
+        pn[2*n+1] = (unsigned int)(b >> 32);
+    }
+    
 public:
 
     bool operator!() const
     {
-        for (int i = 0; i < WIDTH; i++)
-            if (pn[i] != 0)
+        for (int i = 0; i < WORDS; i++)
+            if (Get64(i) != 0)
                 return false;
         return true;
     }
@@ -110,16 +126,16 @@ public:
     base_uint& operator<<=(unsigned int shift)
     {
         base_uint a(*this);
-        for (int i = 0; i < WIDTH; i++)
-            pn[i] = 0;
-        int k = shift / 32;
-        shift = shift % 32;
-        for (int i = 0; i < WIDTH; i++)
+        int k = shift / 64;
+        shift = shift % 64;
+        for (int i = WORDS-1; i >= 0; i--)
         {
-            if (i+k+1 < WIDTH && shift != 0)
-                pn[i+k+1] |= (a.pn[i] >> (32-shift));
-            if (i+k < WIDTH)
-                pn[i+k] |= (a.pn[i] << shift);
+            uint64 n = 0;
+            if (i-k >= 0)
+                n = a.Get64(i-k) << shift;
+            if (i-k-1 >= 0 && shift != 0)
+                n |= a.Get64(i-k-1) >> (64-shift);
+            Set64(i, n);
         }
         return *this;
     }
@@ -127,16 +143,16 @@ public:
     base_uint& operator>>=(unsigned int shift)
     {
         base_uint a(*this);
-        for (int i = 0; i < WIDTH; i++)
-            pn[i] = 0;
-        int k = shift / 32;
-        shift = shift % 32;
-        for (int i = 0; i < WIDTH; i++)
+        int k = shift / 64;
+        shift = shift % 64;
+        for (int i = 0; i < WORDS; i++)
         {
-            if (i-k-1 >= 0 && shift != 0)
-                pn[i-k-1] |= (a.pn[i] << (32-shift));
-            if (i-k >= 0)
-                pn[i-k] |= (a.pn[i] >> shift);
+            uint64 n = 0;
+            if (i+k < WORDS)
+                n = a.Get64(i+k) >> shift;
+            if (i+k+1 < WORDS && shift != 0)
+                n |= a.Get64(i+k+1) << (64-shift);
+            Set64(i, n);
         }
         return *this;
     }
@@ -144,18 +160,25 @@ public:
     base_uint& operator+=(const base_uint& b)
     {
         uint64 carry = 0;
-        for (int i = 0; i < WIDTH; i++)
+        for (int i = 0; i < WORDS; i++)
         {
-            uint64 n = carry + pn[i] + b.pn[i];
-            pn[i] = n & 0xffffffff;
-            carry = n >> 32;
+            uint64 a = Get64(i);
+            uint64 n = a + b.Get64(i) + carry;
+            carry = (n < a || (carry && n == a)) ? 1 : 0;
+            Set64(i, n);
         }
         return *this;
     }
 
     base_uint& operator-=(const base_uint& b)
     {
-        *this += -b;
+        uint64 borrow = 0;
+        for (int i = 0; i < WORDS; i++)
+        {
+            uint64 a = Get64(i), c = b.Get64(i);
+            Set64(i, a - c - borrow);
+            borrow = (a < c || (borrow && a == c)) ? 1 : 0;
+        }
         return *this;
     }
 
@@ -211,70 +234,54 @@ public:
     }
 
 
-    friend inline bool operator<(const base_uint& a, const base_uint& b)
+    /** Three way comparison from the most significant word down. **/
+    int CompareTo(const base_uint& b) const
     {
-        for (int i = base_uint::WIDTH-1; i >= 0; i--)
+        for (int i = WORDS-1; i >= 0; i--)
         {
-            if (a.pn[i] < b.pn[i])
-                return true;
-            else if (a.pn[i] > b.pn[i])
-                return false;
+            uint64 x = Get64(i), y = b.Get64(i);
+            if (x < y)
+                return -1;
+            if (x > y)
+                return 1;
         }
-        return false;
+        return 0;
+    }
+
+    friend inline bool operator<(const base_uint& a, const base_uint& b)
+    {
+        return a.CompareTo(b) < 0;
     }
 
     friend inline bool operator<=(const base_uint& a, const base_uint& b)
     {
-        for (int i = base_uint::WIDTH-1; i >= 0; i--)
-        {
-            if (a.pn[i] < b.pn[i])
-                return true;
-            else if (a.pn[i] > b.pn[i])
-                return false;
-        }
-        return true;
+        return a.CompareTo(b) <= 0;
     }
 
     friend inline bool operator>(const base_uint& a, const base_uint& b)
     {
-        for (int i = base_uint::WIDTH-1; i >= 0; i--)
-        {
-            if (a.pn[i] > b.pn[i])
-                return true;
-            else if (a.pn[i] < b.pn[i])
-                return false;
-        }
-        return false;
+        return a.CompareTo(b) > 0;
     }
 
     friend inline bool operator>=(const base_uint& a, const base_uint& b)
     {
-        for (int i = base_uint::WIDTH-1; i >= 0; i--)
-        {
-            if (a.pn[i] > b.pn[i])
-                return true;
-            else if (a.pn[i] < b.pn[i])
-                return false;
-        }
-        return true;
+        return a.CompareTo(b) >= 0;
     }
 
     friend inline bool operator==(const base_uint& a, const base_uint& b)
     {
-        for (int i = 0; i < base_uint::WIDTH; i++)
-            if (a.pn[i] != b.pn[i])
+        for (int i = 0; i < base_uint::WORDS; i++)
+            if (a.Get64(i) != b.Get64(i))
                 return false;
         return true;
     }
 
     friend inline bool operator==(const base_uint& a, uint64 b)
     {
-        if (a.pn[0] != (unsigned int)b)
-            return false;
-        if (a.pn[1] != (unsigned int)(b >> 32))
+        if (a.Get64(0) != b)
             return false;
-        for (int i = 2; i < base_uint::WIDTH; i++)
-            if (a.pn[i] != 0)
+        for (int i = 1; i < base_uint::WORDS; i++)
+            if (a.Get64(i) != 0)
                 return false;
         return true;
     }
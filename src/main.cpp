@@ -31,6 +31,9 @@ using namespace boost;
 Wallet::CWallet* pwalletMain;
 LLP::Server<LLP::CoreLLP>* LLP_SERVER;
 
+/** Set once mempool.dat was loaded, so a Shutdown from a failed start never overwrites it with an empty pool. **/
+static bool fMempoolLoaded = false;
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // Shutdown
@@ -75,6 +78,9 @@ void Shutdown(void* parg)
 
         Wallet::DBFlush(false);
         Net::StopNode();
+        Core::StopMiningLLP();
+        if (fMempoolLoaded)
+            Core::DumpMempool();
         Wallet::DBFlush(true);
         boost::filesystem::remove(GetPidFile());
         Core::UnregisterWallet(pwalletMain);
@@ -141,6 +147,19 @@ bool AppInit(int argc, char* argv[])
     return fRet;
 }
 
+/** Log the Result of one -selftest Check. **/
+static bool SelfTestResult(const char* pszName, bool fPassed)
+{
+    printf("selftest %-20s %s\n", pszName, fPassed ? "passed" : "FAILED");
+    return fPassed;
+}
+
+/** Benchmarks run by -bench: the one it names, or all of them. **/
+static bool BenchSelected(const char* pszName)
+{
+    return mapArgs["-bench"].empty() || mapArgs["-bench"] == pszName;
+}
+
 bool AppInit2(int argc, char* argv[])
 {
 #ifdef _MSC_VER
@@ -220,6 +239,9 @@ bool AppInit2(int argc, char* argv[])
             "  -bantime=<n>     \t  "   + _("Number of seconds to keep misbehaving peers from reconnecting (default: 86400)") + "\n" +
             "  -maxreceivebuffer=<n>\t  " + _("Maximum per-connection receive buffer, <n>*1000 bytes (default: 10000)") + "\n" +
             "  -maxsendbuffer=<n>\t  "   + _("Maximum per-connection send buffer, <n>*1000 bytes (default: 10000)") + "\n" +
+            "  -maxmempool=<n>  \t  "   + _("Keep the transaction memory pool below <n> megabytes (default: 300)") + "\n" +
+            "  -persistmempool  \t  "   + _("Save the memory pool on shutdown and load it on startup (default: 1)") + "\n" +
+            "  -maxrelaycache=<n>\t  "  + _("Keep relayed messages for peers to request below <n> megabytes (default: 50)") + "\n" +
 #ifdef USE_UPNP
 #if USE_UPNP
             "  -upnp            \t  "   + _("Use Universal Plug and Play to map the listening port (default: 1)") + "\n" +
@@ -252,7 +274,9 @@ bool AppInit2(int argc, char* argv[])
             "  -keypool=<n>     \t  "   + _("Set key pool size to <n> (default: 100)") + "\n" +
             "  -rescan          \t  "   + _("Rescan the block chain for missing wallet transactions") + "\n" +
             "  -checkblocks=<n> \t\t  " + _("How many blocks to check at startup (default: 2500, 0 = all)") + "\n" +
-            "  -checklevel=<n>  \t\t  " + _("How thorough the block verification is (0-6, default: 1)") + "\n";
+            "  -checklevel=<n>  \t\t  " + _("How thorough the block verification is (0-6, default: 1)") + "\n" +
+            "  -selftest        \t\t  " + _("Check internal data structures after loading, then exit") + "\n" +
+            "  -bench=<name>    \t\t  " + _("Run the named benchmark, or all with no name, after loading, then exit") + "\n";
 
         strUsage += string() +
             _("\nSSL options: (see the Nexus Wiki for SSL setup instructions)") + "\n" +
@@ -485,6 +509,16 @@ bool AppInit2(int argc, char* argv[])
     }
 	
 
+    if (GetBoolArg("-persistmempool", true))
+    {
+        InitMessage(_("Loading memory pool..."));
+        printf("Loading memory pool...\n");
+        nStart = GetTimeMillis();
+        Core::LoadMempool();
+        fMempoolLoaded = true;
+        printf(" mempool     %15" PRI64d "ms\n", GetTimeMillis() - nStart);
+    }
+
     InitMessage(_("Done loading"));
     printf("Done loading\n");
 
@@ -537,6 +571,41 @@ bool AppInit2(int argc, char* argv[])
         return false;
     }
 
+    if (mapArgs.count("-selftest"))
+    {
+        bool fPassed = true;
+        fPassed &= SelfTestResult("depthcache", Core::SelfTestDepthCache());
+        fPassed &= SelfTestResult("ddostable", LLP::DDOS_Table::SelfTest());
+        fPassed &= SelfTestResult("orphanblockpool", Core::COrphanBlockPool::SelfTest());
+        fPassed &= SelfTestResult("mempoolpackages", Core::CTxMemPool::SelfTest());
+        fPassed &= SelfTestResult("testpoolview", Core::SelfTestTestPoolView());
+        fPassed &= SelfTestResult("compactblock", Core::CCompactBlock::SelfTest());
+        fPassed &= SelfTestResult("rollingbloomfilter", CRollingBloomFilter::SelfTest());
+
+        printf("selftest %s\n", fPassed ? "passed" : "FAILED");
+        return false;
+    }
+
+    if (mapArgs.count("-bench"))
+    {
+        if (BenchSelected("balance"))
+            Wallet::BenchBalance(100000);
+
+        if (BenchSelected("uint"))
+            BenchUint();
+
+        if (BenchSelected("llp"))
+            LLP::BenchPackets();
+
+        if (BenchSelected("testpool"))
+            Core::BenchTestPool(20000);
+
+        if (BenchSelected("relay"))
+            Core::BenchRelay(125, 2000);
+
+        return false;
+    }
+
     if (mapArgs.count("-proxy"))
     {
         Net::fUseProxy = true;
@@ -561,6 +630,7 @@ bool AppInit2(int argc, char* argv[])
     }
 
     Net::fAllowDNS = GetBoolArg("-dns");
+    Net::cRelayCache.SetMaxBytes(GetArg("-maxrelaycache", 50) * 1000000);
     fNoListen = !GetBoolArg("-listen", true);
 
     if (!fNoListen)
@@ -62,9 +62,7 @@ namespace Net
 
 	vector<CNode*> vNodes;
 	CCriticalSection cs_vNodes;
-	map<CInv, CDataStream> mapRelay;
-	deque<pair<int64, CInv> > vRelayExpiration;
-	CCriticalSection cs_mapRelay;
+	CRelayCache cRelayCache(50 * 1000000);
 	map<CInv, int64> mapAlreadyAskedFor;
 
 
@@ -383,9 +381,219 @@ namespace Net
 			printf("disconnecting node %s\n", addr.ToString().c_str());
 			closesocket(hSocket);
 			hSocket = INVALID_SOCKET;
-			vRecv.clear();
+			vRecvMsg.clear();
+			nRecvSize = 0;
 		}
 	}
+	
+	
+	void FinishMessage(CDataStream& vMsg, unsigned int nHeaderStart, unsigned int nMessageStart)
+	{
+		// Set the size
+		unsigned int nSize = vMsg.size() - nMessageStart;
+		memcpy((char*)&vMsg[nHeaderStart] + offsetof(CMessageHeader, nMessageSize), &nSize, sizeof(nSize));
+
+		// Set the checksum
+		uint512 hash = SK512(vMsg.begin() + nMessageStart, vMsg.end());
+		unsigned int nChecksum = 0;
+		memcpy(&nChecksum, &hash, sizeof(nChecksum));
+		assert(nMessageStart - nHeaderStart >= offsetof(CMessageHeader, nChecksum) + sizeof(nChecksum));
+		memcpy((char*)&vMsg[nHeaderStart] + offsetof(CMessageHeader, nChecksum), &nChecksum, sizeof(nChecksum));
+	}
+	
+	
+	/** The framed Message plus the map, list and expiration records that track it. **/
+	uint64 CRelayCache::EntryUsage(const CSendBuffer& pmsg)
+	{
+		return pmsg->size() + sizeof(CDataStream) + sizeof(CRelayEntry) + 3 * sizeof(CInv) + 6 * sizeof(void*);
+	}
+	
+	
+	void CRelayCache::Erase(std::map<CInv, CRelayEntry>::iterator it)
+	{
+		nBytes -= EntryUsage(it->second.pmsg);
+		lRecent.erase(it->second.itRecent);
+		mapEntries.erase(it);
+	}
+	
+	
+	void CRelayCache::Expire(int64 nNow)
+	{
+		while (!vExpiration.empty() && vExpiration.front().first < nNow)
+		{
+			std::map<CInv, CRelayEntry>::iterator it = mapEntries.find(vExpiration.front().second);
+			if (it != mapEntries.end() && it->second.nExpire == vExpiration.front().first)
+			{
+				Erase(it);
+				nExpired++;
+			}
+			
+			vExpiration.pop_front();
+		}
+	}
+	
+	
+	void CRelayCache::Limit()
+	{
+		while (nBytes > nMaxBytes && !lRecent.empty())
+		{
+			Erase(mapEntries.find(lRecent.back()));
+			nEvicted++;
+		}
+		
+		/** Evicted entries leave their records behind, drop them once they outnumber the live ones. **/
+		if (vExpiration.size() > 2 * mapEntries.size() + 1000)
+		{
+			std::deque< std::pair<int64, CInv> > vLive;
+			for (std::deque< std::pair<int64, CInv> >::iterator it = vExpiration.begin(); it != vExpiration.end(); ++it)
+			{
+				std::map<CInv, CRelayEntry>::iterator mi = mapEntries.find(it->second);
+				if (mi != mapEntries.end() && mi->second.nExpire == it->first)
+					vLive.push_back(*it);
+			}
+			
+			vExpiration.swap(vLive);
+		}
+	}
+	
+	
+	void CRelayCache::SetMaxBytes(uint64 nMaxBytesIn)
+	{
+		LOCK(cs);
+		nMaxBytes = nMaxBytesIn;
+		Limit();
+	}
+	
+	
+	void CRelayCache::Add(const CInv& inv, const CSendBuffer& pmsg)
+	{
+		LOCK(cs);
+		int64 nNow = GetUnifiedTimestamp();
+		Expire(nNow);
+		
+		if (mapEntries.count(inv))
+			return;
+			
+		CRelayEntry& entry = mapEntries[inv];
+		entry.pmsg     = pmsg;
+		entry.nExpire  = nNow + RELAY_CACHE_EXPIRE;
+		entry.itRecent = lRecent.insert(lRecent.begin(), inv);
+		
+		vExpiration.push_back(std::make_pair(entry.nExpire, inv));
+		nBytes += EntryUsage(pmsg);
+		
+		Limit();
+	}
+	
+	
+	CSendBuffer CRelayCache::Get(const CInv& inv)
+	{
+		LOCK(cs);
+		Expire(GetUnifiedTimestamp());
+		
+		std::map<CInv, CRelayEntry>::iterator it = mapEntries.find(inv);
+		if (it == mapEntries.end())
+		{
+			nMisses++;
+			return CSendBuffer();
+		}
+		
+		nHits++;
+		lRecent.splice(lRecent.begin(), lRecent, it->second.itRecent);
+		
+		return it->second.pmsg;
+	}
+	
+	
+	void CRelayCache::GetStats(CRelayCacheStats& stats) const
+	{
+		LOCK(cs);
+		stats.nEntries  = mapEntries.size();
+		stats.nBytes    = nBytes;
+		stats.nMaxBytes = nMaxBytes;
+		stats.nHits     = nHits;
+		stats.nMisses   = nMisses;
+		stats.nEvicted  = nEvicted;
+		stats.nExpired  = nExpired;
+	}
+	
+	
+	int CNetMessage::ReadHeader(const char* pch, unsigned int nBytes)
+	{
+		unsigned int nCopy = min((unsigned int)CMessageHeader::HEADER_SIZE - nHdrPos, nBytes);
+		memcpy(&pchHeader[nHdrPos], pch, nCopy);
+		nHdrPos += nCopy;
+		
+		if (nHdrPos < CMessageHeader::HEADER_SIZE)
+			return nCopy;
+			
+		try
+		{
+			CDataStream hdrbuf(pchHeader, pchHeader + CMessageHeader::HEADER_SIZE, vRecv.nType, vRecv.nVersion);
+			hdrbuf >> hdr;
+		}
+		catch (std::exception& e)
+		{
+			return -1;
+		}
+		
+		if (!hdr.IsValid())
+			return -1;
+			
+		// the payload buffer is sized by ReceiveMsgBytes, once nMessageSize has passed the flood limit
+		fInData = true;
+		
+		return nCopy;
+	}
+	
+	
+	int CNetMessage::ReadData(const char* pch, unsigned int nBytes)
+	{
+		unsigned int nCopy = min((unsigned int)vRecv.size() - nDataPos, nBytes);
+		memcpy(&vRecv[nDataPos], pch, nCopy);
+		nDataPos += nCopy;
+		
+		return nCopy;
+	}
+	
+	
+	bool CNode::ReceiveMsgBytes(const char* pch, unsigned int nBytes)
+	{
+		while (nBytes > 0)
+		{
+			// start a new message once the last one is complete
+			if (vRecvMsg.empty() || vRecvMsg.back()->Complete())
+				vRecvMsg.push_back(boost::shared_ptr<CNetMessage>(new CNetMessage(SER_NETWORK, nRecvVersion)));
+				
+			CNetMessage& msg = *vRecvMsg.back();
+			bool fHeader = !msg.fInData;
+			
+			int nRead = fHeader ? msg.ReadHeader(pch, nBytes) : msg.ReadData(pch, nBytes);
+			if (nRead < 0)
+			{
+				printf("ReceiveMsgBytes() : invalid message header %s from %s\n", HexStr(msg.pchHeader, msg.pchHeader + CMessageHeader::HEADER_SIZE).c_str(), addr.ToString().c_str());
+				return false;
+			}
+			
+			if (fHeader && msg.fInData)
+			{
+				nRecvSize += msg.hdr.nMessageSize;
+				if (nRecvSize > ReceiveBufferSize())
+				{
+					printf("socket recv flood control disconnect (%s, %u bytes)\n", msg.hdr.GetCommand().c_str(), msg.hdr.nMessageSize);
+					return false;
+				}
+				
+				// one allocation at the final size, so no payload byte is moved again once received
+				msg.vRecv.resize(msg.hdr.nMessageSize);
+			}
+			
+			pch    += nRead;
+			nBytes -= nRead;
+		}
+		
+		return true;
+	}
 
 	void CNode::Cleanup()
 	{
@@ -520,7 +728,7 @@ namespace Net
 				BOOST_FOREACH(CNode* pnode, vNodesCopy)
 				{
 					if (pnode->fDisconnect ||
-						(pnode->GetRefCount() <= 0 && pnode->vRecv.empty() && pnode->vSend.empty()))
+						(pnode->GetRefCount() <= 0 && pnode->vRecvMsg.empty() && pnode->vProcessMsg.empty() && pnode->vSendMsg.empty()))
 					{
 						// remove from vNodes
 						vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
@@ -586,7 +794,7 @@ namespace Net
 			//
 			struct timeval timeout;
 			timeout.tv_sec  = 0;
-			timeout.tv_usec = 50000; // frequency to poll pnode->vSend
+			timeout.tv_usec = 50000; // frequency to poll pnode->vSendMsg
 
 			fd_set fdsetRecv;
 			fd_set fdsetSend;
@@ -610,7 +818,7 @@ namespace Net
 					hSocketMax = max(hSocketMax, pnode->hSocket);
 					{
 						TRY_LOCK(pnode->cs_vSend, lockSend);
-						if (lockSend && !pnode->vSend.empty())
+						if (lockSend && !pnode->vSendMsg.empty())
 							FD_SET(pnode->hSocket, &fdsetSend);
 					}
 				}
@@ -716,22 +924,33 @@ namespace Net
 					TRY_LOCK(pnode->cs_vRecv, lockRecv);
 					if (lockRecv)
 					{
-						CDataStream& vRecv = pnode->vRecv;
-						unsigned int nPos = vRecv.size();
-
-						if (nPos > ReceiveBufferSize()) {
+						if (pnode->nRecvSize > ReceiveBufferSize()) {
 							if (!pnode->fDisconnect)
-								printf("socket recv flood control disconnect (%d bytes)\n", vRecv.size());
+								printf("socket recv flood control disconnect (%u bytes)\n", pnode->nRecvSize);
 							pnode->CloseSocketDisconnect();
 						}
 						else {
 							// typical socket buffer is 8K-64K
 							char pchBuf[0x10000];
-							int nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+							char* pchRecv = pchBuf;
+							unsigned int nRecv = sizeof(pchBuf);
+
+							// the rest of a payload goes straight into its message, headers through pchBuf
+							CNetMessage* pmsg = pnode->vRecvMsg.empty() ? NULL : pnode->vRecvMsg.back().get();
+							bool fPayload = (pmsg && pmsg->fInData && !pmsg->Complete());
+							if (fPayload)
+							{
+								pchRecv = &pmsg->vRecv[pmsg->nDataPos];
+								nRecv = pmsg->vRecv.size() - pmsg->nDataPos;
+							}
+
+							int nBytes = recv(pnode->hSocket, pchRecv, nRecv, MSG_DONTWAIT);
 							if (nBytes > 0)
 							{
-								vRecv.resize(nPos + nBytes);
-								memcpy(&vRecv[nPos], pchBuf, nBytes);
+								if (fPayload)
+									pmsg->nDataPos += nBytes;
+								else if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
+									pnode->CloseSocketDisconnect();
 								pnode->nLastRecv = GetUnifiedTimestamp();
 							}
 							else if (nBytes == 0)
@@ -766,13 +985,41 @@ namespace Net
 					TRY_LOCK(pnode->cs_vSend, lockSend);
 					if (lockSend)
 					{
-						CDataStream& vSend = pnode->vSend;
-						if (!vSend.empty())
+						if (!pnode->vSendMsg.empty())
 						{
-							int nBytes = send(pnode->hSocket, &vSend[0], vSend.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+	#ifdef WIN32
+							const CDataStream& vMsg = *pnode->vSendMsg.front();
+							int nBytes = send(pnode->hSocket, &vMsg[pnode->nSendOffset], vMsg.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+	#else
+							// gather the queued messages into one call, the first from where the last send stopped
+							struct iovec iov[64];
+							int nIov = 0;
+							unsigned int nOffset = pnode->nSendOffset;
+							for (deque<CSendBuffer>::iterator it = pnode->vSendMsg.begin(); it != pnode->vSendMsg.end() && nIov < 64; ++it)
+							{
+								iov[nIov].iov_base = (void*)&(**it)[nOffset];
+								iov[nIov].iov_len  = (*it)->size() - nOffset;
+								nIov++;
+								nOffset = 0;
+							}
+
+							struct msghdr msg;
+							memset(&msg, 0, sizeof(msg));
+							msg.msg_iov    = iov;
+							msg.msg_iovlen = nIov;
+							int nBytes = sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+	#endif
 							if (nBytes > 0)
 							{
-								vSend.erase(vSend.begin(), vSend.begin() + nBytes);
+								// release the messages that went out completely
+								pnode->nSendSize -= nBytes;
+								unsigned int nSent = pnode->nSendOffset + nBytes;
+								while (!pnode->vSendMsg.empty() && nSent >= pnode->vSendMsg.front()->size())
+								{
+									nSent -= pnode->vSendMsg.front()->size();
+									pnode->vSendMsg.pop_front();
+								}
+								pnode->nSendOffset = nSent;
 								pnode->nLastSend = GetUnifiedTimestamp();
 							}
 							else if (nBytes < 0)
@@ -785,9 +1032,9 @@ namespace Net
 									pnode->CloseSocketDisconnect();
 								}
 							}
-							if (vSend.size() > SendBufferSize()) {
+							if (pnode->nSendSize > SendBufferSize()) {
 								if (!pnode->fDisconnect)
-									printf("socket send flood control disconnect (%d bytes)\n", vSend.size());
+									printf("socket send flood control disconnect (%u bytes)\n", pnode->nSendSize);
 								pnode->CloseSocketDisconnect();
 							}
 						}
@@ -797,7 +1044,7 @@ namespace Net
 				//
 				// Inactivity checking
 				//
-				if (pnode->vSend.empty())
+				if (pnode->vSendMsg.empty())
 					pnode->nLastSendEmpty = GetUnifiedTimestamp();
 				if (GetUnifiedTimestamp() - pnode->nTimeConnected > 600)
 				{
@@ -1348,10 +1595,6 @@ namespace Net
 			}
 
 			// Poll the connected nodes for messages
-			CNode* pnodeTrickle = NULL;
-			if (!vNodesCopy.empty())
-				pnodeTrickle = vNodesCopy[GetRand(vNodesCopy.size())];
-				
 			BOOST_FOREACH(CNode* pnode, vNodesCopy)
 			{
 				// Receive messages
@@ -1367,7 +1610,7 @@ namespace Net
 				{
 					TRY_LOCK(pnode->cs_vSend, lockSend);
 					if (lockSend)
-						Core::SendMessages(pnode, pnode == pnodeTrickle);
+						Core::SendMessages(pnode);
 				}
 				if (fShutdown)
 					return;
@@ -1580,6 +1823,12 @@ namespace Net
 		if (!CreateThread(ThreadMessageHandler, NULL))
 			printf("Error: CreateThread(ThreadMessageHandler) failed\n");
 
+		// Checksum, deserialize and check messages ahead of the message handler. Messages only become ready through a worker, so there is always one.
+		int nMessageWorkers = max((int64)1, GetArg("-msgworkers", 2));
+		for (int i = 0; i < nMessageWorkers; i++)
+			if (!CreateThread(Core::ThreadMessageWorker, NULL))
+				printf("Error: CreateThread(ThreadMessageWorker) failed\n");
+
 		// Dump network addresses
 		if (!CreateThread(ThreadDumpAddress, NULL))
 			printf("Error; CreateThread(ThreadDumpAddress) failed\n");
@@ -1616,6 +1865,7 @@ namespace Net
 		if (vnThreadsRunning[THREAD_ADDEDCONNECTIONS] > 0) printf("ThreadOpenAddedConnections still running\n");
 		if (vnThreadsRunning[THREAD_DUMPADDRESS] > 0) printf("ThreadDumpAddresses still running\n");
 		if (vnThreadsRunning[THREAD_MINTER] > 0) printf("ThreadStakeMinter still running\n");
+		if (vnThreadsRunning[THREAD_MESSAGEWORKER] > 0) printf("ThreadMessageWorker still running\n");
 		while (vnThreadsRunning[THREAD_MESSAGEHANDLER] > 0 || vnThreadsRunning[THREAD_RPCSERVER] > 0)
 			Sleep(20);
 		Sleep(50);
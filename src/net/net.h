@@ -10,20 +10,23 @@
 #define NEXUS_NET_H
 
 #include <deque>
+#include <list>
 #include <boost/array.hpp>
 #include <boost/foreach.hpp>
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
 #include <openssl/rand.h>
 
 #ifndef WIN32
 #include <arpa/inet.h>
 #endif
 
-#include "../util/mruset.h"
+#include "../util/bloom.h"
 #include "netbase.h"
 #include "protocol.h"
 #include "addrman.h"
 
-namespace Core { class CBlockIndex; }
+namespace Core { class CBlockIndex; class CBlock; class CTransaction; }
 namespace Wallet { class CAddrDB; }
 
 /** Thread types */
@@ -39,6 +42,7 @@ enum threadId
 	THREAD_ADDEDCONNECTIONS,
 	THREAD_DUMPADDRESS,
 	THREAD_MINTER,
+	THREAD_MESSAGEWORKER,
 
 	THREAD_MAX
 };
@@ -100,9 +104,6 @@ namespace Net
 
 	extern std::vector<CNode*> vNodes;
 	extern CCriticalSection cs_vNodes;
-	extern std::map<CInv, CDataStream> mapRelay;
-	extern std::deque<std::pair<int64, CInv> > vRelayExpiration;
-	extern CCriticalSection cs_mapRelay;
 	extern std::map<CInv, int64> mapAlreadyAskedFor;
 
 
@@ -128,6 +129,137 @@ namespace Net
 
 
 
+	/** A complete outgoing Message: the Header with its size and checksum, then the Payload. It is immutable
+		once built and shared by every Peer it is queued on, so a Message sent to many Peers is serialized
+		and checksummed only once. **/
+	typedef boost::shared_ptr<const CDataStream> CSendBuffer;
+	
+	
+	/** Fill in the size and checksum of the Header at nHeaderStart for the Payload that follows it. **/
+	void FinishMessage(CDataStream& vMsg, unsigned int nHeaderStart, unsigned int nMessageStart);
+	
+	
+	/** Serialize and frame a Message that can be queued on any number of Peers. **/
+	template<typename T>
+	CSendBuffer MakeMessage(const char* pszCommand, const T& obj, int nVersion)
+	{
+		boost::shared_ptr<CDataStream> pmsg(new CDataStream(SER_NETWORK, nVersion));
+		*pmsg << CMessageHeader(pszCommand, 0);
+		
+		unsigned int nMessageStart = pmsg->size();
+		*pmsg << obj;
+		FinishMessage(*pmsg, 0, nMessageStart);
+		
+		return pmsg;
+	}
+
+	
+	
+	/** Seconds a relayed Message is kept for Peers to request it. **/
+	static const int64 RELAY_CACHE_EXPIRE = 15 * 60;
+	
+	
+	/** Counters of the Relay Cache, a snapshot for the RPC. **/
+	class CRelayCacheStats
+	{
+	public:
+		uint64 nEntries;
+		uint64 nBytes;
+		uint64 nMaxBytes;
+		uint64 nHits;
+		uint64 nMisses;
+		uint64 nEvicted;
+		uint64 nExpired;
+	};
+	
+	
+	/** Messages we relayed, kept framed so a getdata for one is answered by queueing the shared buffer
+		instead of copying it into the send stream of every Peer that asks. Entries expire after
+		RELAY_CACHE_EXPIRE seconds, and the least recently requested go first once the cache is over budget. **/
+	class CRelayCache
+	{
+		struct CRelayEntry
+		{
+			CSendBuffer pmsg;
+			int64 nExpire;
+			std::list<CInv>::iterator itRecent;
+		};
+		
+		std::map<CInv, CRelayEntry> mapEntries;
+		
+		/** Most recently added or requested first. **/
+		std::list<CInv> lRecent;
+		
+		/** Insertion order, which is also expiration order. Records of entries already evicted are skipped. **/
+		std::deque< std::pair<int64, CInv> > vExpiration;
+		
+		uint64 nBytes, nMaxBytes;
+		uint64 nHits, nMisses, nEvicted, nExpired;
+		
+		mutable CCriticalSection cs;
+		
+		static uint64 EntryUsage(const CSendBuffer& pmsg);
+		void Erase(std::map<CInv, CRelayEntry>::iterator it);
+		void Expire(int64 nNow);
+		void Limit();
+		
+	public:
+		CRelayCache(uint64 nMaxBytesIn) : nBytes(0), nMaxBytes(nMaxBytesIn), nHits(0), nMisses(0), nEvicted(0), nExpired(0) { }
+		
+		void SetMaxBytes(uint64 nMaxBytesIn);
+		
+		/** Keep the Message for inv. The first copy seen is kept, so the original serialization is what gets served. **/
+		void Add(const CInv& inv, const CSendBuffer& pmsg);
+		
+		/** Message for inv, or an empty buffer if it expired or was never relayed. **/
+		CSendBuffer Get(const CInv& inv);
+		
+		void GetStats(CRelayCacheStats& stats) const;
+	};
+	
+	extern CRelayCache cRelayCache;
+
+
+
+	/** A Message received from a Peer. The Socket Handler fills in the Header, then the Payload into a
+		buffer sized from nMessageSize. The Message Workers verify its Checksum and Deserialize and run the
+		context free Checks on Blocks and Transactions outside of cs_main, then flag it Ready so the
+		Message Handler can Dispatch it in the order it was Received. **/
+	class CNetMessage
+	{
+	public:
+		CMessageHeader hdr;
+		CDataStream vRecv;
+		
+		/** Receive state, used by the Socket Handler. **/
+		char pchHeader[CMessageHeader::HEADER_SIZE];
+		unsigned int nHdrPos;
+		unsigned int nDataPos;
+		bool fInData;
+		
+		/** Results of the Message Worker. **/
+		bool fChecksum;
+		bool fChecked;
+		bool fValid;
+		std::string strError;
+		boost::shared_ptr<Core::CBlock> pblock;
+		boost::shared_ptr<Core::CTransaction> ptx;
+		
+		/** Set by the Message Worker once its Results may be read. **/
+		boost::atomic<bool> fReady;
+		
+		CNetMessage(int nType, int nVersion) :
+			vRecv(nType, nVersion), nHdrPos(0), nDataPos(0), fInData(false), fChecksum(false), fChecked(false), fValid(false), fReady(false) { }
+			
+		bool Complete() const { return fInData && nDataPos == hdr.nMessageSize; }
+		
+		/** Consume up to nBytes of Header or Payload. Returns the Bytes used, or -1 for an invalid Header. **/
+		int ReadHeader(const char* pch, unsigned int nBytes);
+		int ReadData(const char* pch, unsigned int nBytes);
+	};
+
+
+
 	/** Information about a peer */
 	class CNode
 	{
@@ -136,9 +268,22 @@ namespace Net
 		uint64 nServices;
 		SOCKET hSocket;
 		CDataStream vSend;
-		CDataStream vRecv;
 		CCriticalSection cs_vSend;
+		
+		// finished messages waiting on the socket, the bytes they hold and how far into the first one was sent
+		std::deque<CSendBuffer> vSendMsg;
+		unsigned int nSendSize;
+		unsigned int nSendOffset;
 		CCriticalSection cs_vRecv;
+		
+		// messages being received, the last one possibly partial, and the payload bytes they hold
+		std::deque< boost::shared_ptr<CNetMessage> > vRecvMsg;
+		unsigned int nRecvSize;
+		int nRecvVersion;
+		
+		// received messages waiting on the message workers, in order received
+		std::deque< boost::shared_ptr<CNetMessage> > vProcessMsg;
+		unsigned int nProcessMsgSize;
 		int64 nLastSend;
 		int64 nLastRecv;
 		int64 nLastSendEmpty;
@@ -178,14 +323,22 @@ namespace Net
 		std::set<CAddress> setAddrKnown;
 		bool fGetAddr;
 		uint1024 hashCheckpointKnown; // Nexus: known sent sync-checkpoint
+		
+		/** Peer asked with sendcmpct to get new Blocks as Compact Blocks instead of an inv. **/
+		bool fPreferCompact;
 
 		// inventory based relay
-		mruset<CInv> setInventoryKnown;
+		CRollingBloomFilter filterInventoryKnown;
 		std::vector<CInv> vInventoryToSend;
+		std::vector<CInv> vBlockInventoryToSend;
 		CCriticalSection cs_inventory;
+		
+		/** Next time in milliseconds the trickled Transaction inv and addr Messages go out to this Peer. **/
+		int64 nNextInvSend;
+		int64 nNextAddrSend;
 		std::multimap<int64, CInv> mapAskFor;
 
-		CNode(SOCKET hSocketIn, CAddress addrIn, bool fInboundIn=false) : vSend(SER_NETWORK, MIN_PROTO_VERSION), vRecv(SER_NETWORK, MIN_PROTO_VERSION)
+		CNode(SOCKET hSocketIn, CAddress addrIn, bool fInboundIn=false) : vSend(SER_NETWORK, MIN_PROTO_VERSION), filterInventoryKnown(20000, 0.000001)
 		{
 			nServices = 0;
 			hSocket = hSocketIn;
@@ -193,6 +346,11 @@ namespace Net
 			nLastRecv = 0;
 			nLastSendEmpty = GetUnifiedTimestamp();
 			nTimeConnected = GetUnifiedTimestamp();
+			nSendSize = 0;
+			nSendOffset = 0;
+			nRecvSize = 0;
+			nRecvVersion = MIN_PROTO_VERSION;
+			nProcessMsgSize = 0;
 			nHeaderStart = -1;
 			nMessageStart = -1;
 			addr = addrIn;
@@ -212,9 +370,11 @@ namespace Net
 			hashLastGetBlocksEnd = 0;
 			nStartingHeight = -1;
 			fGetAddr = false;
+			fPreferCompact = false;
 			nMisbehavior = 0;
 			hashCheckpointKnown = 0;
-			setInventoryKnown.max_size(SendBufferSize() / 1000);
+			nNextInvSend = 0;
+			nNextAddrSend = 0;
 
 			// Be shy and don't send version until we hear
 			if (!fInbound)
@@ -276,15 +436,27 @@ namespace Net
 		{
 			{
 				LOCK(cs_inventory);
-				setInventoryKnown.insert(inv);
+				filterInventoryKnown.insert(BEGIN(inv.hash), END(inv.hash));
 			}
 		}
+		
+		bool IsInventoryKnown(const CInv& inv)
+		{
+			LOCK(cs_inventory);
+			return filterInventoryKnown.contains(BEGIN(inv.hash), END(inv.hash));
+		}
 
+		/** Blocks are announced on the next pass of SendMessages, everything else waits for this Peer's trickle timer. **/
 		void PushInventory(const CInv& inv)
 		{
 			{
 				LOCK(cs_inventory);
-				if (!setInventoryKnown.count(inv))
+				if (filterInventoryKnown.contains(BEGIN(inv.hash), END(inv.hash)))
+					return;
+					
+				if (inv.type == MSG_BLOCK)
+					vBlockInventoryToSend.push_back(inv);
+				else
 					vInventoryToSend.push_back(inv);
 			}
 		}
@@ -349,16 +521,15 @@ namespace Net
 			if (nHeaderStart < 0)
 				return;
 
-			// Set the size
+			// Set the size and checksum
 			unsigned int nSize = vSend.size() - nMessageStart;
-			memcpy((char*)&vSend[nHeaderStart] + offsetof(CMessageHeader, nMessageSize), &nSize, sizeof(nSize));
+			FinishMessage(vSend, nHeaderStart, nMessageStart);
 
-			// Set the checksum
-			uint512 hash = SK512(vSend.begin() + nMessageStart, vSend.end());
-			unsigned int nChecksum = 0;
-			memcpy(&nChecksum, &hash, sizeof(nChecksum));
-			assert(nMessageStart - nHeaderStart >= offsetof(CMessageHeader, nChecksum) + sizeof(nChecksum));
-			memcpy((char*)&vSend[nHeaderStart] + offsetof(CMessageHeader, nChecksum), &nChecksum, sizeof(nChecksum));
+			// Move the finished message onto the send queue without copying it
+			boost::shared_ptr<CDataStream> pmsg(new CDataStream(vSend.nType, vSend.nVersion));
+			pmsg->swap(vSend);
+			vSendMsg.push_back(pmsg);
+			nSendSize += pmsg->size();
 
 			if (fDebug) {
 				printf("(%d bytes)\n", nSize);
@@ -369,6 +540,14 @@ namespace Net
 			LEAVE_CRITICAL_SECTION(cs_vSend);
 		}
 
+		/** Queue a Message built once with MakeMessage, shared with any other Peers it goes to. **/
+		void PushBuffer(const CSendBuffer& pmsg)
+		{
+			LOCK(cs_vSend);
+			vSendMsg.push_back(pmsg);
+			nSendSize += pmsg->size();
+		}
+
 		void EndMessageAbortIfEmpty()
 		{
 			if (nHeaderStart < 0)
@@ -594,6 +773,7 @@ namespace Net
 		bool IsSubscribed(unsigned int nChannel);
 		void Subscribe(unsigned int nChannel, unsigned int nHops=0);
 		void CancelSubscribe(unsigned int nChannel);
+		bool ReceiveMsgBytes(const char* pch, unsigned int nBytes);
 		void CloseSocketDisconnect();
 		void Cleanup();
 
@@ -649,19 +829,8 @@ namespace Net
 	template<>
 	inline void RelayMessage<>(const CInv& inv, const CDataStream& ss)
 	{
-		{
-			LOCK(cs_mapRelay);
-			// Expire old relay messages
-			while (!vRelayExpiration.empty() && vRelayExpiration.front().first < GetUnifiedTimestamp())
-			{
-				mapRelay.erase(vRelayExpiration.front().second);
-				vRelayExpiration.pop_front();
-			}
-
-			// Save original serialized message so newer versions are preserved
-			mapRelay.insert(std::make_pair(inv, ss));
-			vRelayExpiration.push_back(std::make_pair(GetUnifiedTimestamp() + 15 * 60, inv));
-		}
+		// Frame the original serialized message so newer versions are preserved
+		cRelayCache.Add(inv, MakeMessage(inv.GetCommand(), ss, PROTOCOL_VERSION));
 
 		RelayInventory(inv);
 	}
@@ -66,7 +66,7 @@ namespace Net
 
 		// TODO: make private (improves encapsulation)
 		public:
-			enum { COMMAND_SIZE=12 };
+			enum { COMMAND_SIZE=12, HEADER_SIZE=4+COMMAND_SIZE+4+4 };
 			unsigned char pchMessageStart[4];
 			char pchCommand[COMMAND_SIZE];
 			unsigned int nMessageSize;
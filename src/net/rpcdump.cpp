@@ -44,16 +44,57 @@ namespace Net
 		}
 	};
 	
+	/** Runs the rescan outside of the RPC locks so the wallet stays usable while it works. **/
+	void ThreadRescanWallet(void* parg)
+	{
+		int nFound = pwalletMain->ScanForWalletTransactions(Core::pindexGenesisBlock, true);
+		printf("ThreadRescanWallet : Rescan Complete, %d Transactions Updated\n", nFound);
+		
+		MainFrameRepaint();
+	}
+	
 	Value rescan(const Array& params, bool fHelp)
 	{
 		if (fHelp || params.size() != 0)
 			throw runtime_error(
 				"rescan\n"
-				"Rescans the database for relevant wallet transactions.");
+				"Starts a rescan of the database for relevant wallet transactions.\n"
+				"Use getrescanprogress to follow the rescan.");
+				
+		/** Flag early so a second request cannot start another scan before the thread does. **/
+		if (pwalletMain->fScanning.exchange(true))
+			throw JSONRPCError(-4, "Wallet is already rescanning");
 				
-		pwalletMain->ScanForWalletTransactions(Core::pindexGenesisBlock, true);
+		if (!CreateThread(ThreadRescanWallet, NULL))
+		{
+			pwalletMain->fScanning = false;
+			throw JSONRPCError(-4, "Failed to start rescan thread");
+		}
 		
-		return "Wallet Rescanning Complete";
+		return "Wallet Rescanning Started";
+	}
+	
+	Value getrescanprogress(const Array& params, bool fHelp)
+	{
+		if (fHelp || params.size() != 0)
+			throw runtime_error(
+				"getrescanprogress\n"
+				"Returns the progress of the running wallet rescan.");
+				
+		Object obj;
+		bool fScanning    = pwalletMain->fScanning.load();
+		int nScanHeight   = pwalletMain->nScanHeight.load();
+		int nFinalHeight  = pwalletMain->nScanFinalHeight.load();
+		
+		obj.push_back(Pair("scanning", fScanning));
+		if (fScanning)
+		{
+			obj.push_back(Pair("height",  nScanHeight));
+			obj.push_back(Pair("final",   nFinalHeight));
+			obj.push_back(Pair("percent", (nFinalHeight > 0) ? (100.0 * nScanHeight) / nFinalHeight : 100.0));
+		}
+		
+		return obj;
 	}
 
 	Value importprivkey(const Array& params, bool fHelp)
@@ -90,6 +131,9 @@ namespace Net
 
 			if (!pwalletMain->AddKey(key))
 				throw JSONRPCError(-4,"Error adding key to wallet");
+				
+			/** Outputs already in the wallet may pay the new key. **/
+			pwalletMain->RebuildCoinIndex();
 		}
 
 		MainFrameRepaint();
@@ -172,6 +216,12 @@ namespace Net
 			
 				response.push_back(Pair(entry[nIndex].name_, "Successfully Imported"));
 			}
+			
+			/** Outputs already in the wallet may pay the new keys, index them once for the whole list. **/
+			{
+				LOCK2(Core::cs_main, pwalletMain->cs_wallet);
+				pwalletMain->RebuildCoinIndex();
+			}
 
 			MainFrameRepaint();
 
@@ -57,6 +57,7 @@ namespace Net
 	extern Value exportkeys(const Array& params, bool fHelp);
 	extern Value importkeys(const Array& params, bool fHelp);
 	extern Value rescan(const Array& params, bool fHelp);
+	extern Value getrescanprogress(const Array& params, bool fHelp);
 	
 
 	Object JSONRPCError(int code, const string& message)
@@ -308,6 +309,32 @@ namespace Net
 	}
 
 
+	Value getrelayinfo(const Array& params, bool fHelp)
+	{
+		if (fHelp || params.size() != 0)
+			throw runtime_error(
+				"getrelayinfo\n"
+				"Returns the size and hit rate of the cache of relayed messages.");
+
+		CRelayCacheStats stats;
+		cRelayCache.GetStats(stats);
+		
+		uint64 nRequests = stats.nHits + stats.nMisses;
+
+		Object obj;
+		obj.push_back(Pair("entries",   (uint64_t)stats.nEntries));
+		obj.push_back(Pair("bytes",     (uint64_t)stats.nBytes));
+		obj.push_back(Pair("maxbytes",  (uint64_t)stats.nMaxBytes));
+		obj.push_back(Pair("hits",      (uint64_t)stats.nHits));
+		obj.push_back(Pair("misses",    (uint64_t)stats.nMisses));
+		obj.push_back(Pair("hitrate",   nRequests ? (double)stats.nHits / nRequests : 0.0));
+		obj.push_back(Pair("evicted",   (uint64_t)stats.nEvicted));
+		obj.push_back(Pair("expired",   (uint64_t)stats.nExpired));
+		
+		return obj;
+	}
+
+
 	Value getdifficulty(const Array& params, bool fHelp)
 	{
 		if (fHelp || params.size() != 0)
@@ -420,6 +447,41 @@ namespace Net
 	}
 
 
+	Value getminingstats(const Array& params, bool fHelp)
+	{
+		if (fHelp || params.size() != 0)
+			throw runtime_error(
+				"getminingstats\n"
+				"Returns the share and hashrate counters of each Mining LLP worker.\n"
+				"Shares are accepted when -mining_sharefactor (hash channel) or -mining_primeshare (prime channel) is set.");
+
+		vector<Core::CMiningStats> vStats;
+		Core::GetMiningStats(vStats);
+		
+		Array ret;
+		BOOST_FOREACH(const Core::CMiningStats& stats, vStats)
+		{
+			Object obj;
+			obj.push_back(Pair("address",    stats.strAddress));
+			obj.push_back(Pair("channel",    Core::GetChannelName(stats.nChannel)));
+			obj.push_back(Pair("connected",  (int)stats.nConnected));
+			obj.push_back(Pair("shares",     (boost::uint64_t)stats.nShares));
+			obj.push_back(Pair("rejected",   (boost::uint64_t)stats.nRejected));
+			obj.push_back(Pair("blocks",     (boost::uint64_t)stats.nBlocks));
+			obj.push_back(Pair("sharerate",  stats.dShareRate));
+			
+			if(stats.nChannel == 2)
+				obj.push_back(Pair("hashrate", stats.dHashRate));
+			else if(stats.nChannel == 1)
+				obj.push_back(Pair("difficulty", stats.dDifficulty));
+				
+			ret.push_back(obj);
+		}
+		
+		return ret;
+	}
+
+
 	Value getnewaddress(const Array& params, bool fHelp)
 	{
 		if (fHelp || params.size() > 1)
@@ -2303,10 +2365,12 @@ namespace Net
 		{ "getblocknumber",         &getblocknumber,         true },
 		{ "getconnectioncount",     &getconnectioncount,     true },
 		{ "getpeerinfo",            &getpeerinfo,            true },
+		{ "getrelayinfo",           &getrelayinfo,           true },
 		{ "getdifficulty",          &getdifficulty,          true },
 		{ "getsupplyrates",         &getsupplyrate,          true },
 		{ "getinfo",                &getinfo,                true },
 		{ "getmininginfo",          &getmininginfo,          true },
+		{ "getminingstats",         &getminingstats,         true },
 		{ "getnewaddress",          &getnewaddress,          true },
 		{ "getaccountaddress",      &getaccountaddress,      true },
 		{ "setaccount",             &setaccount,             true },
@@ -2321,6 +2385,7 @@ namespace Net
 		{ "exportkeys",             &exportkeys,             false },
 		{ "importkeys",             &importkeys,             false },
 		{ "rescan",                 &rescan,                 false },
+		{ "getrescanprogress",      &getrescanprogress,      true },
 		{ "backupwallet",           &backupwallet,           true },
 		{ "keypoolrefill",          &keypoolrefill,          true },
 		{ "walletpassphrase",       &walletpassphrase,       true },
@@ -0,0 +1,170 @@
+/*******************************************************************************************
+
+			Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+ [Learn and Create] Viz. http://www.opensource.org/licenses/mit-license.php
+
+*******************************************************************************************/
+
+#ifndef NEXUS_BLOOM_H
+#define NEXUS_BLOOM_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "util.h"
+
+/** Bloom filter that forgets its oldest entries. Two generations of bits are kept: inserts go to the
+    current one, and once it holds nElements/2 keys the older generation is cleared and takes over.
+    Remembers at least the last nElements/2 and at most the last nElements keys, with a constant
+    memory footprint and no allocation per insert. Keys are arbitrary byte ranges that are already
+    well distributed, such as hashes. */
+class CRollingBloomFilter
+{
+protected:
+    std::vector<uint64> vData[2];
+    unsigned int nCurrent;
+    unsigned int nInserted;
+    unsigned int nGenerationSize;
+    unsigned int nHashFuncs;
+    uint64 nSalt0, nSalt1;
+
+    static uint64 Mix(uint64 x)
+    {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    /** Two salted 64 bit hashes of the key, combined as h1 + i*h2 for the i'th hash function. */
+    void Hash(const unsigned char* pbegin, const unsigned char* pend, uint64& h1, uint64& h2) const
+    {
+        h1 = nSalt0;
+        h2 = nSalt1;
+        while (pbegin < pend)
+        {
+            uint64 nWord = 0;
+            size_t nBytes = std::min((size_t)(pend - pbegin), sizeof(nWord));
+            memcpy(&nWord, pbegin, nBytes);
+            pbegin += nBytes;
+
+            h1 = Mix(h1 ^ nWord);
+            h2 = Mix(h2 + nWord);
+        }
+        h2 |= 1;
+    }
+
+    bool Test(unsigned int nGeneration, uint64 h1, uint64 h2) const
+    {
+        const std::vector<uint64>& vBits = vData[nGeneration];
+        uint64 nBits = vBits.size() * 64;
+        for (unsigned int i = 0; i < nHashFuncs; i++)
+        {
+            uint64 nBit = (h1 + i * h2) % nBits;
+            if (!(vBits[nBit >> 6] & (1ULL << (nBit & 63))))
+                return false;
+        }
+        return true;
+    }
+
+public:
+    CRollingBloomFilter(unsigned int nElements, double dFPRate)
+    {
+        /** Each lookup checks both generations, so each gets half the false positive budget. */
+        nGenerationSize = std::max(1u, nElements / 2);
+        double dBits = -1.0 * nGenerationSize * log(dFPRate / 2) / (log(2.0) * log(2.0));
+        unsigned int nWords = std::max(1u, (unsigned int)(dBits / 64) + 1);
+
+        nHashFuncs = std::max(1, std::min((int)(nWords * 64.0 / nGenerationSize * log(2.0) + 0.5), 50));
+        vData[0].assign(nWords, 0);
+        vData[1].assign(nWords, 0);
+
+        nCurrent = 0;
+        nInserted = 0;
+        nSalt0 = GetRand(std::numeric_limits<uint64>::max());
+        nSalt1 = GetRand(std::numeric_limits<uint64>::max());
+    }
+
+    template<typename T>
+    void insert(const T pbegin, const T pend)
+    {
+        if (nInserted >= nGenerationSize)
+        {
+            nCurrent ^= 1;
+            std::fill(vData[nCurrent].begin(), vData[nCurrent].end(), 0);
+            nInserted = 0;
+        }
+
+        uint64 h1, h2;
+        const unsigned char* p = (const unsigned char*)&pbegin[0];
+        Hash(p, p + (pend - pbegin) * sizeof(pbegin[0]), h1, h2);
+
+        std::vector<uint64>& vBits = vData[nCurrent];
+        uint64 nBits = vBits.size() * 64;
+        for (unsigned int i = 0; i < nHashFuncs; i++)
+        {
+            uint64 nBit = (h1 + i * h2) % nBits;
+            vBits[nBit >> 6] |= (1ULL << (nBit & 63));
+        }
+        nInserted++;
+    }
+
+    template<typename T>
+    bool contains(const T pbegin, const T pend) const
+    {
+        uint64 h1, h2;
+        const unsigned char* p = (const unsigned char*)&pbegin[0];
+        Hash(p, p + (pend - pbegin) * sizeof(pbegin[0]), h1, h2);
+        return Test(nCurrent, h1, h2) || Test(nCurrent ^ 1, h1, h2);
+    }
+
+    void reset()
+    {
+        std::fill(vData[0].begin(), vData[0].end(), 0);
+        std::fill(vData[1].begin(), vData[1].end(), 0);
+        nInserted = 0;
+    }
+
+    /** Self-check: recent keys are always found, old keys are forgotten by generation, and the
+        false positive rate on keys never inserted stays near the configured rate. */
+    static bool SelfTest()
+    {
+        CRollingBloomFilter filter(100, 0.001);
+        for (uint64 n = 0; n < 1000; n++)
+        {
+            filter.insert((const unsigned char*)&n, (const unsigned char*)&n + sizeof(n));
+
+            /** At least the last nElements/2 keys have to be remembered after every insert. */
+            for (uint64 k = (n < 49 ? 0 : n - 49); k <= n; k++)
+                if (!filter.contains((const unsigned char*)&k, (const unsigned char*)&k + sizeof(k)))
+                    return false;
+        }
+
+        /** Keys from the first generations were cleared long ago. */
+        unsigned int nOld = 0;
+        for (uint64 k = 0; k < 500; k++)
+            if (filter.contains((const unsigned char*)&k, (const unsigned char*)&k + sizeof(k)))
+                nOld++;
+
+        unsigned int nFalse = 0;
+        for (uint64 k = 1000000; k < 1010000; k++)
+            if (filter.contains((const unsigned char*)&k, (const unsigned char*)&k + sizeof(k)))
+                nFalse++;
+
+        /** 0.1% expected, so 10 of 10000. Fail only well outside of that. */
+        if (nOld > 5 || nFalse > 100)
+            return false;
+
+        uint64 nLast = 999;
+        filter.reset();
+        return !filter.contains((const unsigned char*)&nLast, (const unsigned char*)&nLast + sizeof(nLast));
+    }
+};
+
+#endif
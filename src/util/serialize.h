@@ -912,6 +912,12 @@ public:
         nReadPos = 0;
     }
 
+    void swap(CDataStream& other)
+    {
+        vch.swap(other.vch);
+        std::swap(nReadPos, other.nReadPos);
+    }
+
     bool Rewind(size_type n)
     {
         // Rewind by n characters if the buffer hasn't been compacted yet
@@ -199,6 +199,71 @@ uint512 GetRand512()
 }
 
 
+/** Time per Operation in Nanoseconds of nOps Operations taking nMillis. **/
+static double NanosPerOp(int64 nMillis, uint64 nOps)
+{
+    return (double)nMillis * 1000000.0 / nOps;
+}
+
+/** Microbenchmarks of uint1024 Comparison, Lookup as a Map Key, Shifts and Addition. Run with -bench=uint. **/
+void BenchUint()
+{
+    const unsigned int nKeys = 100000, nRounds = 20;
+
+    /** Random Keys differ in their top Word like Block Hashes. Target Keys share all but their low Word,
+        the worst case for a Comparison, like Proof of Work Hashes against their Target. **/
+    std::vector<uint1024> vKeys(nKeys), vTargets(nKeys);
+    for (unsigned int i = 0; i < nKeys; i++)
+    {
+        RAND_bytes((unsigned char*)&vKeys[i], sizeof(vKeys[i]));
+        vTargets[i] = vKeys[0];
+        vTargets[i] += i;
+    }
+
+    unsigned int nLess = 0;
+    int64 nStart = GetTimeMillis();
+    for (unsigned int n = 0; n < nRounds; n++)
+        for (unsigned int i = 1; i < nKeys; i++)
+            nLess += (vKeys[i - 1] < vKeys[i]) + (vKeys[i - 1] == vKeys[i]);
+    double dCompare = NanosPerOp(GetTimeMillis() - nStart, (uint64)nRounds * (nKeys - 1) * 2);
+
+    nStart = GetTimeMillis();
+    for (unsigned int n = 0; n < nRounds; n++)
+        for (unsigned int i = 1; i < nKeys; i++)
+            nLess += (vTargets[i - 1] < vTargets[i]) + (vTargets[i - 1] == vTargets[i]);
+    double dCompareTarget = NanosPerOp(GetTimeMillis() - nStart, (uint64)nRounds * (nKeys - 1) * 2);
+
+    std::map<uint1024, unsigned int> mapKeys;
+    for (unsigned int i = 0; i < nKeys; i++)
+        mapKeys[vKeys[i]] = i;
+
+    unsigned int nFound = 0;
+    nStart = GetTimeMillis();
+    for (unsigned int n = 0; n < nRounds; n++)
+        for (unsigned int i = 0; i < nKeys; i++)
+            nFound += mapKeys.count(vKeys[(i * 7919) % nKeys]);
+    double dLookup = NanosPerOp(GetTimeMillis() - nStart, (uint64)nRounds * nKeys);
+
+    nStart = GetTimeMillis();
+    for (unsigned int n = 0; n < nRounds; n++)
+        for (unsigned int i = 0; i < nKeys; i++)
+        {
+            vKeys[i] <<= (i % 97) + 1;
+            vKeys[i] >>= (i % 89) + 1;
+        }
+    double dShift = NanosPerOp(GetTimeMillis() - nStart, (uint64)nRounds * nKeys * 2);
+
+    nStart = GetTimeMillis();
+    for (unsigned int n = 0; n < nRounds; n++)
+        for (unsigned int i = 1; i < nKeys; i++)
+            vKeys[i] += vKeys[i - 1];
+    double dAdd = NanosPerOp(GetTimeMillis() - nStart, (uint64)nRounds * (nKeys - 1));
+
+    printf("bench uint: compare %.1f ns, compare near target %.1f ns, map lookup %.1f ns in %u keys, shift %.1f ns, add %.1f ns (%u %u)\n",
+        dCompare, dCompareTarget, dLookup, nKeys, dShift, dAdd, nLess, nFound);
+}
+
+
 
 
 
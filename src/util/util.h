@@ -132,7 +132,7 @@ template <typename A, typename B> std::multimap<B, A> flip_map(std::map<A,B> & s
 			
 			
 /** Convert a byte stream into a signed integer 32 bit. **/	
-inline int bytes2int(std::vector<unsigned char> BYTES, int nOffset = 0) { return (BYTES[0 + nOffset] << 24) + (BYTES[1 + nOffset] << 16) + (BYTES[2 + nOffset] << 8) + BYTES[3 + nOffset]; }
+inline int bytes2int(const std::vector<unsigned char>& BYTES, int nOffset = 0) { return (BYTES[0 + nOffset] << 24) + (BYTES[1 + nOffset] << 16) + (BYTES[2 + nOffset] << 8) + BYTES[3 + nOffset]; }
 		
 
 /** Convert a 32 bit signed Integer to Byte Vector using Bitwise Shifts. **/
@@ -149,7 +149,7 @@ inline std::vector<unsigned char> int2bytes(int INT)
 			
 			
 /** Convert a byte stream into unsigned integer 32 bit. **/	
-inline unsigned int bytes2uint(std::vector<unsigned char> BYTES, int nOffset = 0) { return (BYTES[0 + nOffset] << 24) + (BYTES[1 + nOffset] << 16) + (BYTES[2 + nOffset] << 8) + BYTES[3 + nOffset]; }		
+inline unsigned int bytes2uint(const std::vector<unsigned char>& BYTES, int nOffset = 0) { return (BYTES[0 + nOffset] << 24) + (BYTES[1 + nOffset] << 16) + (BYTES[2 + nOffset] << 8) + BYTES[3 + nOffset]; }		
 			
 			
 /** Convert a 64 bit Unsigned Integer to Byte Vector using Bitwise Shifts. **/
@@ -168,7 +168,7 @@ inline std::vector<unsigned char> uint2bytes64(uint64 UINT)
 
 			
 /** Convert a byte Vector into unsigned integer 64 bit. **/
-inline uint64 bytes2uint64(std::vector<unsigned char> BYTES, int nOffset = 0) { return (bytes2uint(BYTES, nOffset) | ((uint64)bytes2uint(BYTES, nOffset + 4) << 32)); }
+inline uint64 bytes2uint64(const std::vector<unsigned char>& BYTES, int nOffset = 0) { return (bytes2uint(BYTES, nOffset) | ((uint64)bytes2uint(BYTES, nOffset + 4) << 32)); }
 
 
 /** Convert Standard String into Byte Vector. **/
@@ -295,6 +295,7 @@ int GetRandInt(int nMax);
 uint64 GetRand(uint64 nMax);
 uint256 GetRand256();
 uint512 GetRand512();
+void BenchUint();
 std::string FormatFullVersion();
 std::string FormatSubVersion(const std::string& name, int nClientVersion, const std::vector<std::string>& comments);
 
@@ -497,14 +497,20 @@ namespace Wallet
 		return Write(string("hashBestChain"), hashBestChain);
 	}
 
-	bool CTxDB::ReadBestInvalidTrust(CBigNum& bnBestInvalidTrust)
+	/** Kept on disk in the CBigNum format of older databases. **/
+	bool CTxDB::ReadBestInvalidTrust(uint256& nBestInvalidTrust)
 	{
-		return Read(string("bnBestInvalidTrust"), bnBestInvalidTrust);
+		CBigNum bnBestInvalidTrust;
+		if (!Read(string("bnBestInvalidTrust"), bnBestInvalidTrust))
+			return false;
+			
+		nBestInvalidTrust = bnBestInvalidTrust.getuint256();
+		return true;
 	}
 
-	bool CTxDB::WriteBestInvalidTrust(CBigNum bnBestInvalidTrust)
+	bool CTxDB::WriteBestInvalidTrust(uint256 nBestInvalidTrust)
 	{
-		return Write(string("bnBestInvalidTrust"), bnBestInvalidTrust);
+		return Write(string("bnBestInvalidTrust"), CBigNum(nBestInvalidTrust));
 	}
 
 	bool CTxDB::ReadCheckpointPubKey(string& strPubKey)
@@ -586,6 +592,8 @@ namespace Wallet
 					pindexNew->nBits          = diskindex.nBits;
 					pindexNew->nNonce         = diskindex.nNonce;
 					pindexNew->nTime          = diskindex.nTime;
+					
+					Core::mapBlockPositions[make_pair(pindexNew->nFile, pindexNew->nBlockPos)] = pindexNew;
 
 					// Watch for genesis block
 					if (Core::pindexGenesisBlock == NULL && diskindex.GetBlockHash() == Core::hashGenesisBlock)
@@ -621,7 +629,8 @@ namespace Wallet
 			return error("CTxDB::LoadBlockIndex() : hashBestChain not found in the block index");
 		Core::pindexBest = Core::mapBlockIndex[Core::hashBestChain];
 		Core::nBestHeight = Core::pindexBest->nHeight;
-		Core::bnBestChainTrust = Core::pindexBest->bnChainTrust;
+		Core::nBestChainGeneration++;
+		Core::nBestChainTrust = Core::pindexBest->nChainTrust;
 		
 		Core::CBlockIndex* pindex = Core::pindexGenesisBlock;
 		
@@ -705,7 +714,7 @@ namespace Wallet
 				
 				
 			/** Calculate the Chain Trust. **/
-			pindex->bnChainTrust = (pindex->pprev ? pindex->pprev->bnChainTrust : 0) + pindex->GetBlockTrust();
+			pindex->nChainTrust = (pindex->pprev ? pindex->pprev->nChainTrust : 0) + pindex->GetBlockTrust();
 			
 			
 			/** Release the Nexus Rewards into the Blockchain. **/
@@ -736,7 +745,7 @@ namespace Wallet
 			/** Exit the Loop on the Best Block. **/
 			if(pindex->GetBlockHash() == Core::hashBestChain)
 			{
-				printf("LoadBlockIndex(): hashBestChain=%s  height=%d  trust=%s\n", Core::hashBestChain.ToString().substr(0,20).c_str(), Core::nBestHeight, Core::bnBestChainTrust.ToString().c_str());
+				printf("LoadBlockIndex(): hashBestChain=%s  height=%d  trust=%" PRIu64 "\n", Core::hashBestChain.ToString().substr(0,20).c_str(), Core::nBestHeight, Core::nBestChainTrust.Get64());
 				break;
 			}
 			
@@ -744,8 +753,8 @@ namespace Wallet
 			pindex = pindex->pnext;
 		}
 
-		// Load bnBestInvalidTrust, OK if it doesn't exist
-		ReadBestInvalidTrust(Core::bnBestInvalidTrust);
+		// Load nBestInvalidTrust, OK if it doesn't exist
+		ReadBestInvalidTrust(Core::nBestInvalidTrust);
 		
 		
 
@@ -65,6 +65,38 @@ namespace Wallet
 		return false;
 	}
 
+	void CBasicKeyStore::GetCScripts(ScriptMap &mapScriptsRet) const
+	{
+		LOCK(cs_KeyStore);
+		mapScriptsRet = mapScripts;
+	}
+
+	CKeyStoreSnapshot::CKeyStoreSnapshot(const CBasicKeyStore& keystore)
+	{
+		keystore.GetKeys(setAddresses);
+		keystore.GetCScripts(mapScripts);
+	}
+
+	bool CKeyStoreSnapshot::AddCScript(const CScript& redeemScript)
+	{
+		return false;
+	}
+
+	bool CKeyStoreSnapshot::HaveCScript(const uint256& hash) const
+	{
+		return (mapScripts.count(hash) > 0);
+	}
+
+	bool CKeyStoreSnapshot::GetCScript(const uint256 &hash, CScript& redeemScriptOut) const
+	{
+		ScriptMap::const_iterator mi = mapScripts.find(hash);
+		if (mi == mapScripts.end())
+			return false;
+			
+		redeemScriptOut = (*mi).second;
+		return true;
+	}
+
 	bool CCryptoKeyStore::SetCrypted()
 	{
 		{
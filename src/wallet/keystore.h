@@ -99,6 +99,7 @@ namespace Wallet
 		virtual bool AddCScript(const CScript& redeemScript);
 		virtual bool HaveCScript(const uint256 &hash) const;
 		virtual bool GetCScript(const uint256 &hash, CScript& redeemScriptOut) const;
+		void GetCScripts(ScriptMap &mapScriptsRet) const;
 	};
 
 	typedef std::map<NexusAddress, std::pair<std::vector<unsigned char>, std::vector<unsigned char> > > CryptedKeyMap;
@@ -190,5 +191,26 @@ namespace Wallet
 			}
 		}
 	};
+	
+	
+	/** Read only copy of the addresses and scripts of another key store. Holds no secrets and takes no locks,
+		so many threads can test script ownership against it at once (used by the wallet rescan). **/
+	class CKeyStoreSnapshot : public CKeyStore
+	{
+	private:
+		std::set<NexusAddress> setAddresses;
+		ScriptMap mapScripts;
+		
+	public:
+		CKeyStoreSnapshot(const CBasicKeyStore& keystore);
+		
+		bool AddKey(const CKey& key) { return false; }
+		bool HaveKey(const NexusAddress &address) const { return setAddresses.count(address) > 0; }
+		bool GetKey(const NexusAddress &address, CKey& keyOut) const { return false; }
+		void GetKeys(std::set<NexusAddress> &setAddress) const { setAddress = setAddresses; }
+		bool AddCScript(const CScript& redeemScript);
+		bool HaveCScript(const uint256 &hash) const;
+		bool GetCScript(const uint256 &hash, CScript& redeemScriptOut) const;
+	};
 }
 #endif
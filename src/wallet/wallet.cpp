@@ -33,6 +33,7 @@ namespace Wallet
 	{
 		if (!CCryptoKeyStore::AddKey(key))
 			return false;
+		Core::cTrustPool.AddWalletKey(this, key.GetPubKey());
 		if (!fFileBacked)
 			return true;
 		if (!IsCrypted())
@@ -44,6 +45,7 @@ namespace Wallet
 	{
 		if (!CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret))
 			return false;
+		Core::cTrustPool.AddWalletKey(this, vchPubKey);
 		if (!fFileBacked)
 			return true;
 		{
@@ -287,6 +289,7 @@ namespace Wallet
 						printf("WalletUpdateSpent found spent coin %s Nexus %s\n", FormatMoney(wtx.GetCredit()).c_str(), wtx.GetHash().ToString().c_str());
 						wtx.MarkSpent(txin.prevout.n);
 						wtx.WriteToDisk();
+						UpdateCoinIndex(wtx);
 						vWalletUpdated.push_back(txin.prevout.hash);
 					}
 				}
@@ -302,6 +305,110 @@ namespace Wallet
 				item.second.MarkDirty();
 		}
 	}
+	
+	void CWallet::EraseCoinIndex(const CWalletTx& wtx)
+	{
+		nCoinIndexVersion++;
+		for (unsigned int i = 0; i < wtx.vout.size(); i++)
+		{
+			pair<multimap<int64, pair<const CWalletTx*, unsigned int> >::iterator, multimap<int64, pair<const CWalletTx*, unsigned int> >::iterator> range = mapCoinIndex.equal_range(wtx.vout[i].nValue);
+			for (multimap<int64, pair<const CWalletTx*, unsigned int> >::iterator it = range.first; it != range.second; ++it)
+			{
+				if (it->second.first == &wtx && it->second.second == i)
+				{
+					nCoinIndexTotal -= it->first;
+					mapCoinIndex.erase(it);
+					
+					break;
+				}
+			}
+			
+			/** Keep the Stakeable Outputs a subset of the Coin Index. **/
+			if (setStakePending.erase(make_pair(&wtx, i)))
+				continue;
+				
+			range = mapStakeable.equal_range(wtx.vout[i].nValue);
+			for (multimap<int64, pair<const CWalletTx*, unsigned int> >::iterator it = range.first; it != range.second; ++it)
+			{
+				if (it->second.first == &wtx && it->second.second == i)
+				{
+					nStakeableTotal -= it->first;
+					mapStakeable.erase(it);
+					
+					break;
+				}
+			}
+		}
+	}
+	
+	void CWallet::UpdateCoinIndex(const CWalletTx& wtx)
+	{
+		EraseCoinIndex(wtx);
+		for (unsigned int i = 0; i < wtx.vout.size(); i++)
+		{
+			if (wtx.IsSpent(i) || wtx.vout[i].nValue <= 0 || !IsMine(wtx.vout[i]))
+				continue;
+				
+			mapCoinIndex.insert(make_pair(wtx.vout[i].nValue, make_pair(&wtx, i)));
+			nCoinIndexTotal += wtx.vout[i].nValue;
+			
+			setStakePending.insert(make_pair(&wtx, i));
+			fStakePendingDirty = true;
+		}
+	}
+	
+	void CWallet::RebuildCoinIndex()
+	{
+		LOCK(cs_wallet);
+		mapCoinIndex.clear();
+		nCoinIndexTotal = 0;
+		nCoinIndexVersion++;
+		
+		setStakePending.clear();
+		mapStakeable.clear();
+		nStakeableTotal = 0;
+		
+		for (map<uint512, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+			UpdateCoinIndex((*it).second);
+	}
+
+	/** Outputs of a transaction can be staked once it is final, confirmed to the same depth as coin selection, and mature. **/
+	bool CWallet::IsStakeable(const CWalletTx* pcoin) const
+	{
+		if (!pcoin->IsFinal() || !pcoin->IsConfirmed())
+			return false;
+
+		if ((pcoin->IsCoinBase() || pcoin->IsCoinStake()) && pcoin->GetBlocksToMaturity() > 0)
+			return false;
+			
+		return (pcoin->GetDepthInMainChain() >= 3);
+	}
+	
+	/** Move pending outputs that became stakeable. Depth only grows with the best chain, so this only needs to
+		run once per new best block, or after outputs were added. Reorganizations are caught in SelectStakeCoins. **/
+	void CWallet::UpdateStakeable()
+	{
+		if (!fStakePendingDirty && nStakeGeneration == Core::nBestChainGeneration)
+			return;
+			
+		for (set<pair<const CWalletTx*, unsigned int> >::iterator it = setStakePending.begin(); it != setStakePending.end(); )
+		{
+			if (!IsStakeable(it->first))
+			{
+				++it;
+				continue;
+			}
+			
+			int64 nValue = it->first->vout[it->second].nValue;
+			mapStakeable.insert(make_pair(nValue, *it));
+			nStakeableTotal += nValue;
+			
+			setStakePending.erase(it++);
+		}
+		
+		fStakePendingDirty = false;
+		nStakeGeneration = Core::nBestChainGeneration;
+	}
 
 	bool CWallet::AddToWallet(const CWalletTx& wtxIn)
 	{
@@ -364,6 +471,9 @@ namespace Wallet
 				}
 			}
 	#endif
+			// Keep the unspent index current with the merged spent flags
+			UpdateCoinIndex(wtx);
+
 			// Notify UI
 			vWalletUpdated.push_back(hash);
 
@@ -407,8 +517,14 @@ namespace Wallet
 			return false;
 		{
 			LOCK(cs_wallet);
-			if (mapWallet.erase(hash))
+			map<uint512, CWalletTx>::iterator mi = mapWallet.find(hash);
+			if (mi != mapWallet.end())
+			{
+				EraseCoinIndex((*mi).second);
+				mapWallet.erase(mi);
+				
 				CWalletDB(strWalletFile).EraseTx(hash);
+			}
 		}
 		return true;
 	}
@@ -669,25 +785,226 @@ namespace Wallet
 	// Scan the block chain (starting in pindexStart) for transactions
 	// from or to us. If fUpdate is true, found transactions that already
 	// exist in the wallet will be updated.
+	/** Block travelling through the rescan pipeline along with the result of its ownership filter. **/
+	struct CScanBlock
+	{
+		Core::CBlock block;
+		std::vector<bool> vfMatch;
+		bool fFiltered;
+		
+		CScanBlock() : fFiltered(false) { }
+	};
+	
+	
+	/** Disk position and hash of a block to be scanned, copied from the block index under cs_main
+		so the reader never touches the index while the best chain moves. **/
+	struct CScanPos
+	{
+		unsigned int nFile, nBlockPos;
+		uint1024 hashBlock;
+	};
+	
+	
+	/** State shared by the rescan reader thread, the filter workers and the committing thread.
+		Blocks leave the queue in chain order so that transactions spending earlier wallet outputs
+		are always seen after the transactions that created them. **/
+	struct CScanPipeline
+	{
+		boost::mutex MUTEX;
+		boost::condition_variable CONDITION;
+		
+		std::deque<CScanBlock*> QUEUE;
+		std::vector<CScanPos> vBlocks;
+		
+		const CKeyStore* pkeystore;
+		
+		/** Position in QUEUE of the next block waiting to be filtered. **/
+		unsigned int nNextFilter;
+		unsigned int nMaxQueue;
+		bool fReadDone, fAbort;
+		
+		CScanPipeline(const CKeyStore* pkeystoreIn, unsigned int nMaxQueueIn) : pkeystore(pkeystoreIn), nNextFilter(0), nMaxQueue(nMaxQueueIn), fReadDone(false), fAbort(false) { }
+	};
+	
+	
+	/** Reads the blocks to be scanned from disk in sequence, staying at most nMaxQueue blocks ahead. **/
+	static void ScanReader(CScanPipeline* pipe)
+	{
+		for(unsigned int nIndex = 0; nIndex < pipe->vBlocks.size(); nIndex++)
+		{
+			const CScanPos& pos = pipe->vBlocks[nIndex];
+			
+			CScanBlock* pscan = new CScanBlock();
+			if (!pscan->block.ReadFromDisk(pos.nFile, pos.nBlockPos, true) || pscan->block.GetHash() != pos.hashBlock)
+			{
+				error("ScanReader() : failed to read block %s", pos.hashBlock.ToString().substr(0, 20).c_str());
+				pscan->block.SetNull();
+			}
+			
+			boost::unique_lock<boost::mutex> lock(pipe->MUTEX);
+			while(pipe->QUEUE.size() >= pipe->nMaxQueue && !pipe->fAbort)
+				pipe->CONDITION.wait(lock);
+				
+			if(pipe->fAbort)
+			{
+				delete pscan;
+				break;
+			}
+			
+			pipe->QUEUE.push_back(pscan);
+			pipe->CONDITION.notify_all();
+		}
+		
+		boost::unique_lock<boost::mutex> lock(pipe->MUTEX);
+		pipe->fReadDone = true;
+		pipe->CONDITION.notify_all();
+	}
+	
+	
+	/** Flags the transactions of queued blocks that pay to a key or script of the snapshot. Runs without the wallet lock. **/
+	static void ScanFilter(CScanPipeline* pipe)
+	{
+		loop
+		{
+			CScanBlock* pscan;
+			{
+				boost::unique_lock<boost::mutex> lock(pipe->MUTEX);
+				while(pipe->nNextFilter >= pipe->QUEUE.size() && !pipe->fReadDone && !pipe->fAbort)
+					pipe->CONDITION.wait(lock);
+					
+				if(pipe->fAbort || pipe->nNextFilter >= pipe->QUEUE.size())
+					return;
+					
+				pscan = pipe->QUEUE[pipe->nNextFilter++];
+			}
+			
+			pscan->vfMatch.assign(pscan->block.vtx.size(), false);
+			for(unsigned int nTx = 0; nTx < pscan->block.vtx.size(); nTx++)
+			{
+				BOOST_FOREACH(const Core::CTxOut& txout, pscan->block.vtx[nTx].vout)
+				{
+					if(IsMine(*pipe->pkeystore, txout.scriptPubKey))
+					{
+						pscan->vfMatch[nTx] = true;
+						break;
+					}
+				}
+			}
+			
+			boost::unique_lock<boost::mutex> lock(pipe->MUTEX);
+			pscan->fFiltered = true;
+			pipe->CONDITION.notify_all();
+		}
+	}
+	
+	
+	/** Scan the chain from pindexStart for wallet transactions. Blocks are read ahead by one thread and
+		filtered against a snapshot of the wallet keys by -rescanthreads workers, while this thread adds the
+		matches to the wallet in chain order. The wallet lock is only taken for transactions that matched
+		a wallet key or touch a transaction already in the wallet. **/
 	int CWallet::ScanForWalletTransactions(Core::CBlockIndex* pindexStart, bool fUpdate)
 	{
 		int ret = 0;
-
-		Core::CBlockIndex* pindex = pindexStart;
+		
+		CKeyStoreSnapshot cKeys(*this);
+		CScanPipeline cPipeline(&cKeys, 64);
+		{
+			LOCK(Core::cs_main);
+			for(Core::CBlockIndex* pindex = pindexStart; pindex; pindex = pindex->pnext)
+			{
+				CScanPos pos;
+				pos.nFile     = pindex->nFile;
+				pos.nBlockPos = pindex->nBlockPos;
+				pos.hashBlock = pindex->GetBlockHash();
+				cPipeline.vBlocks.push_back(pos);
+			}
+			
+			nScanHeight      = pindexStart ? pindexStart->nHeight : 0;
+			nScanFinalHeight = Core::nBestHeight;
+		}
+			
+		if(cPipeline.vBlocks.empty())
+		{
+			fScanning = false;
+			return 0;
+		}
+		
+		/** Hashes of wallet transactions, for catching spends and updates of transactions already known. **/
+		set<uint512> setWalletHashes;
 		{
 			LOCK(cs_wallet);
-			while (pindex)
+			for (map<uint512, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+				setWalletHashes.insert((*it).first);
+		}
+		
+		fScanning = true;
+		
+		int nThreads = std::max((int)GetArg("-rescanthreads", boost::thread::hardware_concurrency()), 1);
+		boost::thread_group THREADS;
+		THREADS.create_thread(boost::bind(&ScanReader, &cPipeline));
+		for(int nThread = 0; nThread < nThreads; nThread++)
+			THREADS.create_thread(boost::bind(&ScanFilter, &cPipeline));
+		
+		loop
+		{
+			CScanBlock* pscan;
 			{
-				Core::CBlock block;
-				block.ReadFromDisk(pindex, true);
-				BOOST_FOREACH(Core::CTransaction& tx, block.vtx)
+				boost::unique_lock<boost::mutex> lock(cPipeline.MUTEX);
+				if(fShutdown)
 				{
-					if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
-						ret++;
+					cPipeline.fAbort = true;
+					cPipeline.CONDITION.notify_all();
+					
+					break;
 				}
-				pindex = pindex->pnext;
+				
+				while(!(!cPipeline.QUEUE.empty() && cPipeline.QUEUE.front()->fFiltered) && !(cPipeline.fReadDone && cPipeline.QUEUE.empty()))
+					cPipeline.CONDITION.wait(lock);
+					
+				if(cPipeline.QUEUE.empty())
+					break;
+					
+				pscan = cPipeline.QUEUE.front();
+				cPipeline.QUEUE.pop_front();
+				cPipeline.nNextFilter--;
+				cPipeline.CONDITION.notify_all();
 			}
+			
+			for(unsigned int nTx = 0; nTx < pscan->block.vtx.size(); nTx++)
+			{
+				const Core::CTransaction& tx = pscan->block.vtx[nTx];
+				uint512 hash = tx.GetHash();
+				
+				bool fCandidate = pscan->vfMatch[nTx] || setWalletHashes.count(hash);
+				for(unsigned int nIn = 0; nIn < tx.vin.size() && !fCandidate; nIn++)
+					fCandidate = setWalletHashes.count(tx.vin[nIn].prevout.hash);
+					
+				if(!fCandidate)
+					continue;
+				
+				/** Setting the merkle branch reads the block index, so hold cs_main while the block is handed to the wallet. **/
+				LOCK2(Core::cs_main, cs_wallet);
+				if (AddToWalletIfInvolvingMe(tx, &pscan->block, fUpdate))
+					ret++;
+					
+				if (mapWallet.count(hash))
+					setWalletHashes.insert(hash);
+			}
+			
+			if (!pscan->block.IsNull())
+				nScanHeight = pscan->block.nHeight;
+				
+			delete pscan;
 		}
+		
+		THREADS.join_all();
+		
+		/** Clean up anything left behind by an aborted scan. **/
+		BOOST_FOREACH(CScanBlock* pscan, cPipeline.QUEUE)
+			delete pscan;
+		
+		fScanning = false;
+		
 		return ret;
 	}
 
@@ -741,6 +1058,7 @@ namespace Wallet
 						printf("ReacceptWalletTransactions found spent coin %s Nexus %s\n", FormatMoney(wtx.GetCredit()).c_str(), wtx.GetHash().ToString().c_str());
 						wtx.MarkDirty();
 						wtx.WriteToDisk();
+						UpdateCoinIndex(wtx);
 					}
 				}
 				else
@@ -842,65 +1160,73 @@ namespace Wallet
 	//
 
 
-	int64 CWallet::GetBalance() const
+	void CWallet::UpdateBalanceCache() const
 	{
-		int64 nTotal = 0;
+		if (fBalanceCached && hashBalanceTip == Core::hashBestChain && nBalanceIndexVersion == nCoinIndexVersion)
+			return;
+			
+		nCachedBalance = nCachedUnconfirmed = nCachedStake = nCachedNewMint = 0;
+		for (multimap<int64, pair<const CWalletTx*, unsigned int> >::const_iterator it = mapCoinIndex.begin(); it != mapCoinIndex.end(); ++it)
 		{
-			LOCK(cs_wallet);
-			for (map<uint512, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+			const CWalletTx* pcoin = it->second.first;
+			if ((pcoin->IsCoinBase() || pcoin->IsCoinStake()) && pcoin->GetBlocksToMaturity() > 0)
 			{
-				const CWalletTx* pcoin = &(*it).second;
-				if (!pcoin->IsFinal() || !pcoin->IsConfirmed())
-					continue;
-				nTotal += pcoin->GetAvailableCredit();
+				// Nexus: coins staked or minted are non-spendable until maturity
+				if (pcoin->GetDepthInMainChain() > 1)
+				{
+					if (pcoin->IsCoinStake())
+						nCachedStake += it->first;
+					else
+						nCachedNewMint += it->first;
+				}
+				
+				continue;
 			}
+			
+			if (pcoin->IsFinal() && pcoin->IsConfirmed())
+				nCachedBalance += it->first;
+			else
+				nCachedUnconfirmed += it->first;
 		}
+		
+		fBalanceCached       = true;
+		hashBalanceTip       = Core::hashBestChain;
+		nBalanceIndexVersion = nCoinIndexVersion;
+	}
+
 
-		return nTotal;
+	int64 CWallet::GetBalance() const
+	{
+		LOCK(cs_wallet);
+		UpdateBalanceCache();
+		
+		return nCachedBalance;
 	}
 	
 
 	int64 CWallet::GetUnconfirmedBalance() const
 	{
-		int64 nTotal = 0;
-		{
-			LOCK(cs_wallet);
-			for (map<uint512, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-			{
-				const CWalletTx* pcoin = &(*it).second;
-				if (pcoin->IsFinal() && pcoin->IsConfirmed())
-					continue;
-				nTotal += pcoin->GetAvailableCredit();
-			}
-		}
-		return nTotal;
+		LOCK(cs_wallet);
+		UpdateBalanceCache();
+		
+		return nCachedUnconfirmed;
 	}
 
 	// Nexus: total coins staked (non-spendable until maturity)
 	int64 CWallet::GetStake() const
 	{
-		int64 nTotal = 0;
 		LOCK(cs_wallet);
-		for (map<uint512, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-		{
-			const CWalletTx* pcoin = &(*it).second;
-			if (pcoin->IsCoinStake() && pcoin->GetBlocksToMaturity() > 0 && pcoin->GetDepthInMainChain() > 1)
-				nTotal += CWallet::GetCredit(*pcoin);
-		}
-		return nTotal;
+		UpdateBalanceCache();
+		
+		return nCachedStake;
 	}
 
 	int64 CWallet::GetNewMint() const
 	{
-		int64 nTotal = 0;
 		LOCK(cs_wallet);
-		for (map<uint512, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-		{
-			const CWalletTx* pcoin = &(*it).second;
-			if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0 && pcoin->GetDepthInMainChain() > 1)
-				nTotal += CWallet::GetCredit(*pcoin);
-		}
-		return nTotal;
+		UpdateBalanceCache();
+		
+		return nCachedNewMint;
 	}
 	
 	// populate vCoins with vector of spendable (age, (value, (transaction, output_number))) outputs
@@ -910,9 +1236,9 @@ namespace Wallet
 
 		{
 			LOCK(cs_wallet);
-			for (map<uint512, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+			for (multimap<int64, pair<const CWalletTx*, unsigned int> >::const_iterator it = mapCoinIndex.begin(); it != mapCoinIndex.end(); ++it)
 			{
-				const CWalletTx* pcoin = &(*it).second;
+				const CWalletTx* pcoin = it->second.first;
 
 				if (!pcoin->IsFinal())
 					continue;
@@ -923,14 +1249,10 @@ namespace Wallet
 				if ((pcoin->IsCoinBase() || pcoin->IsCoinStake()) && pcoin->GetBlocksToMaturity() > 0)
 					continue;
 
-				for (int i = 0; i < pcoin->vout.size(); i++)
-				{
-					if (pcoin->nTime > nSpendTime)
-						continue;  // ppcoin: timestamp must not exceed spend time
+				if (pcoin->nTime > nSpendTime)
+					continue;  // ppcoin: timestamp must not exceed spend time
 
-					if (!(pcoin->IsSpent(i)) && IsMine(pcoin->vout[i]) && pcoin->vout[i].nValue > 0)
-						vCoins.push_back(COutput(pcoin, i, pcoin->GetDepthInMainChain()));
-				}
+				vCoins.push_back(COutput(pcoin, it->second.second, pcoin->GetDepthInMainChain()));
 			}
 		}
 	}
@@ -941,9 +1263,9 @@ namespace Wallet
 		mapAddresses.clear();
 		{
 			LOCK(cs_wallet);
-			for (map<uint512, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+			for (multimap<int64, pair<const CWalletTx*, unsigned int> >::const_iterator it = mapCoinIndex.begin(); it != mapCoinIndex.end(); ++it)
 			{
-				const CWalletTx* pcoin = &(*it).second;
+				const CWalletTx* pcoin = it->second.first;
 
 				if (!pcoin->IsFinal())
 					continue;
@@ -954,23 +1276,17 @@ namespace Wallet
 				if (fOnlyConfirmed && pcoin->GetBlocksToMaturity() > 0)
 					continue;
 
-				for (int i = 0; i < pcoin->vout.size(); i++)
-				{
-					if (pcoin->nTime > nSpendTime)
-						continue;  // ppcoin: timestamp must not exceed spend time
-					
-					if (!(pcoin->IsSpent(i)) && IsMine(pcoin->vout[i]) && pcoin->vout[i].nValue > 0) {
-						NexusAddress cAddress;
-						if(!ExtractAddress(pcoin->vout[i].scriptPubKey, cAddress) || !cAddress.IsValid())
-							return false;
-						
-						if(mapAddresses.count(cAddress))
-							mapAddresses[cAddress] = pcoin->vout[i].nValue;
-						else
-							mapAddresses[cAddress] += pcoin->vout[i].nValue;
-
-					}
-				}
+				if (pcoin->nTime > nSpendTime)
+					continue;  // ppcoin: timestamp must not exceed spend time
+				
+				NexusAddress cAddress;
+				if(!ExtractAddress(pcoin->vout[it->second.second].scriptPubKey, cAddress) || !cAddress.IsValid())
+					return false;
+				
+				if(mapAddresses.count(cAddress))
+					mapAddresses[cAddress] = it->first;
+				else
+					mapAddresses[cAddress] += it->first;
 			}
 		}
 		
@@ -992,15 +1308,17 @@ namespace Wallet
 		int64 nTotalLower = 0;
 
 		{
-		   LOCK(cs_wallet);
-		   vector<const CWalletTx*> vCoins;
-		   vCoins.reserve(mapWallet.size());
-		   for (map<uint512, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-			   vCoins.push_back(&(*it).second);
-		   random_shuffle(vCoins.begin(), vCoins.end(), GetRandInt);
+			LOCK(cs_wallet);
+			
+			/** Nothing to search if every unspent output together cannot cover the target. **/
+			if (nCoinIndexTotal < nTargetValue)
+				return false;
 
-		   BOOST_FOREACH(const CWalletTx* pcoin, vCoins)
-		   {
+			/** The index is ordered by value, so the first eligible coin at or above the
+				target plus CENT is the lowest larger coin and the scan can stop there. **/
+			for (multimap<int64, pair<const CWalletTx*, unsigned int> >::const_iterator it = mapCoinIndex.begin(); it != mapCoinIndex.end(); ++it)
+			{
+				const CWalletTx* pcoin = it->second.first;
 				if (!pcoin->IsFinal() || !pcoin->IsConfirmed())
 					continue;
 
@@ -1011,36 +1329,27 @@ namespace Wallet
 				if (nDepth < (pcoin->IsFromMe() ? nConfMine : nConfTheirs))
 					continue;
 
-				for (unsigned int i = 0; i < pcoin->vout.size(); i++)
-				{
-					if (pcoin->IsSpent(i) || !IsMine(pcoin->vout[i]))
-						continue;
-
-					if (pcoin->nTime > nSpendTime)
-						continue;  // Nexus: timestamp must not exceed spend time
-
-					int64 n = pcoin->vout[i].nValue;
-
-					if (n <= 0)
-						continue;
+				if (pcoin->nTime > nSpendTime)
+					continue;  // Nexus: timestamp must not exceed spend time
 
-					pair<int64,pair<const CWalletTx*,unsigned int> > coin = make_pair(n,make_pair(pcoin,i));
+				int64 n = it->first;
+				pair<int64,pair<const CWalletTx*,unsigned int> > coin = make_pair(n, it->second);
 
-					if (n == nTargetValue)
-					{
-						setCoinsRet.insert(coin.second);
-						nValueRet += coin.first;
-						return true;
-					}
-					else if (n < nTargetValue + CENT)
-					{
-						vValue.push_back(coin);
-						nTotalLower += n;
-					}
-					else if (n < coinLowestLarger.first)
-					{
-						coinLowestLarger = coin;
-					}
+				if (n == nTargetValue)
+				{
+					setCoinsRet.insert(coin.second);
+					nValueRet += coin.first;
+					return true;
+				}
+				else if (n < nTargetValue + CENT)
+				{
+					vValue.push_back(coin);
+					nTotalLower += n;
+				}
+				else
+				{
+					coinLowestLarger = coin;
+					break;
 				}
 			}
 		}
@@ -1130,6 +1439,47 @@ namespace Wallet
 		return true;
 	}
 
+	/** Select the Inputs for a Coinstake, leaving nReserveBalance of the stakeable outputs unstaked. Takes the largest 
+		outputs first until the Stake Weight is reached, so it only visits the outputs it chooses. **/
+	bool CWallet::SelectStakeCoins(int64 nReserveBalance, unsigned int nSpendTime, vector<pair<const CWalletTx*,unsigned int> >& vCoinsRet, int64& nValueRet)
+	{
+		vCoinsRet.clear();
+		nValueRet = 0;
+		
+		LOCK(cs_wallet);
+		UpdateStakeable();
+		
+		if (nStakeableTotal <= nReserveBalance)
+			return false;
+			
+		int64 nTargetValue = std::min((int64)Core::MAX_STAKE_WEIGHT, nStakeableTotal - nReserveBalance);
+		multimap<int64, pair<const CWalletTx*, unsigned int> >::iterator it = mapStakeable.end();
+		while (it != mapStakeable.begin() && nValueRet <= nTargetValue)
+		{
+			--it;
+			
+			/** Outputs can lose their depth in a reorganization. Send them back to be checked again. **/
+			if (!IsStakeable(it->second.first))
+			{
+				setStakePending.insert(it->second);
+				fStakePendingDirty = true;
+				
+				nStakeableTotal -= it->first;
+				mapStakeable.erase(it++);
+				
+				continue;
+			}
+			
+			if (it->second.first->nTime > nSpendTime)
+				continue;
+				
+			vCoinsRet.push_back(it->second);
+			nValueRet += it->first;
+		}
+		
+		return !vCoinsRet.empty();
+	}
+
 	bool CWallet::SelectCoins(int64 nTargetValue, unsigned int nSpendTime, set<pair<const CWalletTx*,unsigned int> >& setCoinsRet, int64& nValueRet) const
 	{
 		return (SelectCoinsMinConf(nTargetValue, nSpendTime, 3, 3, setCoinsRet, nValueRet) ||
@@ -1304,6 +1654,7 @@ namespace Wallet
 					coin.BindWallet(this);
 					coin.MarkSpent(txin.prevout.n);
 					coin.WriteToDisk();
+					UpdateCoinIndex(coin);
 					vWalletUpdated.push_back(coin.GetHash());
 				}
 
@@ -1394,6 +1745,8 @@ namespace Wallet
 			return false;
 		fFirstRunRet = false;
 		int nLoadWalletRet = CWalletDB(strWalletFile,"cr+").LoadWallet(this);
+		RebuildCoinIndex();
+		
 		if (nLoadWalletRet == DB_NEED_REWRITE)
 		{
 			if (CDB::Rewrite(strWalletFile, "\x04pool"))
@@ -1673,6 +2026,7 @@ namespace Wallet
 					{
 						pcoin->MarkUnspent(n);
 						pcoin->WriteToDisk();
+						UpdateCoinIndex(*pcoin);
 					}
 				}
 				else if (IsMine(pcoin->vout[n]) && !pcoin->IsSpent(n) && (txindex.vSpent.size() > n && !txindex.vSpent[n].IsNull()))
@@ -1685,6 +2039,7 @@ namespace Wallet
 					{
 						pcoin->MarkSpent(n);
 						pcoin->WriteToDisk();
+						UpdateCoinIndex(*pcoin);
 					}
 				}
 			}
@@ -1708,6 +2063,7 @@ namespace Wallet
 				{
 					prev.MarkUnspent(txin.prevout.n);
 					prev.WriteToDisk();
+					UpdateCoinIndex(prev);
 				}
 			}
 		}
@@ -1766,5 +2122,64 @@ namespace Wallet
 			setAddress.insert(address);
 		}
 	}
+	
+	
+	/** Benchmark of getbalance on a Wallet of nTransactions, all Confirmed in the Best Block, and of the Depth Queries
+		behind it on a new Block and between Blocks. Run with -bench=balance. **/
+	void BenchBalance(unsigned int nTransactions)
+	{
+		if (!Core::pindexBest)
+			return;
+			
+		CWallet wallet;
+		CKey key;
+		key.MakeNewKey(false);
+		wallet.AddKey(key);
+		
+		CScript scriptPubKey;
+		scriptPubKey.SetNexusAddress(key.GetPubKey());
+		
+		/** The Transactions only claim the Best Block, so their Merkle Branches are marked Verified instead of checked. **/
+		for (unsigned int i = 0; i < nTransactions; i++)
+		{
+			Core::CTransaction tx;
+			tx.vin.resize(1);
+			tx.vin[0].prevout.n = i;
+			tx.vout.resize(1);
+			tx.vout[0].nValue = COIN;
+			tx.vout[0].scriptPubKey = scriptPubKey;
+			
+			CWalletTx wtx(&wallet, tx);
+			wtx.hashBlock = Core::hashBestChain;
+			wtx.nIndex = i;
+			wtx.fMerkleVerified = true;
+			
+			wallet.mapWallet.insert(make_pair(tx.GetHash(), wtx));
+		}
+		wallet.RebuildCoinIndex();
+		
+		Core::nBestChainGeneration++;
+		int64 nStart = GetTimeMillis();
+		int64 nBalance = wallet.GetBalance();
+		int64 nBalanceTime = GetTimeMillis() - nStart;
+		
+		/** Every Depth once after a new Block, then again between Blocks. **/
+		int64 nDepthTime[2];
+		for (int nPass = 0; nPass < 2; nPass++)
+		{
+			if (nPass == 0)
+				Core::nBestChainGeneration++;
+				
+			nStart = GetTimeMillis();
+			for (map<uint512, CWalletTx>::const_iterator it = wallet.mapWallet.begin(); it != wallet.mapWallet.end(); ++it)
+				it->second.IsConfirmed();
+				
+			nDepthTime[nPass] = GetTimeMillis() - nStart;
+		}
+		
+		printf("bench balance: %u transactions, balance %s\n", nTransactions, FormatMoney(nBalance).c_str());
+		printf("bench balance: getbalance on a new block %" PRI64d " ms\n", nBalanceTime);
+		printf("bench balance: IsConfirmed of every transaction %" PRI64d " ms on a new block, %" PRI64d " ms between blocks\n", nDepthTime[0], nDepthTime[1]);
+	}
 
 }
@@ -9,6 +9,8 @@
 #ifndef NEXUS_WALLET_H
 #define NEXUS_WALLET_H
 
+#include <boost/atomic.hpp>
+
 #include "../core/core.h"
 
 #include "key.h"
@@ -68,6 +70,42 @@ namespace Wallet
 		bool SelectCoinsMinConf(int64 nTargetValue, unsigned int nSpendTime, int nConfMine, int nConfTheirs, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, int64& nValueRet) const;
 		bool SelectCoins(int64 nTargetValue, unsigned int nSpendTime, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, int64& nValueRet) const;
 
+		/** Unspent outputs owned by this wallet, ordered by value. Kept current as transactions
+			are added and spent flags change so that balances and coin selection do not need to walk every
+			transaction in mapWallet. Pointers are into mapWallet which does not move its elements. **/
+		std::multimap<int64, std::pair<const CWalletTx*, unsigned int> > mapCoinIndex;
+		
+		/** Running total of the values in mapCoinIndex. **/
+		int64 nCoinIndexTotal;
+		
+		void EraseCoinIndex(const CWalletTx& wtx);
+		void UpdateCoinIndex(const CWalletTx& wtx);
+		
+		/** Bumped on every change to mapCoinIndex. **/
+		unsigned int nCoinIndexVersion;
+		
+		/** Balances of mapCoinIndex by depth class: confirmed and mature, not yet confirmed, and immature
+			stake and mint. Summed in one walk, then reused until the best chain or the index changes. **/
+		mutable int64 nCachedBalance, nCachedUnconfirmed, nCachedStake, nCachedNewMint;
+		mutable uint1024 hashBalanceTip;
+		mutable unsigned int nBalanceIndexVersion;
+		mutable bool fBalanceCached;
+		
+		void UpdateBalanceCache() const;
+		
+		/** Unspent outputs from mapCoinIndex that are not yet confirmed or mature enough to stake.
+			They are only checked again when the best chain or the set itself changed. **/
+		std::set<std::pair<const CWalletTx*, unsigned int> > setStakePending;
+		bool fStakePendingDirty;
+		unsigned int nStakeGeneration;
+		
+		/** Unspent outputs ready to stake, ordered by value, and their running total. **/
+		std::multimap<int64, std::pair<const CWalletTx*, unsigned int> > mapStakeable;
+		int64 nStakeableTotal;
+		
+		bool IsStakeable(const CWalletTx* pcoin) const;
+		void UpdateStakeable();
+
 		CWalletDB *pwalletdbEncryption;
 
 		// the current wallet version: clients below this version are not able to load the wallet
@@ -96,6 +134,15 @@ namespace Wallet
 			fFileBacked = false;
 			nMasterKeyMaxID = 0;
 			pwalletdbEncryption = NULL;
+			nCoinIndexTotal = 0;
+			nCoinIndexVersion = 0;
+			fBalanceCached = false;
+			fStakePendingDirty = false;
+			nStakeGeneration = 0;
+			nStakeableTotal = 0;
+			fScanning = false;
+			nScanHeight = 0;
+			nScanFinalHeight = 0;
 		}
 		CWallet(std::string strWalletFileIn)
 		{
@@ -105,10 +152,23 @@ namespace Wallet
 			fFileBacked = true;
 			nMasterKeyMaxID = 0;
 			pwalletdbEncryption = NULL;
+			nCoinIndexTotal = 0;
+			nCoinIndexVersion = 0;
+			fBalanceCached = false;
+			fStakePendingDirty = false;
+			nStakeGeneration = 0;
+			nStakeableTotal = 0;
+			fScanning = false;
+			nScanHeight = 0;
+			nScanFinalHeight = 0;
 		}
 
 		std::map<uint512, CWalletTx> mapWallet;
 		std::vector<uint512> vWalletUpdated;
+		
+		/** Progress of a running ScanForWalletTransactions, reported over RPC. **/
+		boost::atomic<bool> fScanning;
+		boost::atomic<int> nScanHeight, nScanFinalHeight;
 
 		std::map<uint1024, int> mapRequestCount;
 
@@ -141,6 +201,7 @@ namespace Wallet
 		bool EncryptWallet(const SecureString& strWalletPassphrase);
 
 		void MarkDirty();
+		void RebuildCoinIndex();
 		bool AddToWallet(const CWalletTx& wtxIn);
 		bool AddToWalletIfInvolvingMe(const Core::CTransaction& tx, const Core::CBlock* pblock, bool fUpdate = false, bool fFindBlock = false);
 		bool EraseFromWallet(uint512 hash);
@@ -159,6 +220,7 @@ namespace Wallet
 		
 		bool CreateTransaction(const std::vector<std::pair<CScript, int64> >& vecSend, CWalletTx& wtxNew, CReserveKey& reservekey, int64& nFeeRet);
 		bool CreateTransaction(CScript scriptPubKey, int64 nValue, CWalletTx& wtxNew, CReserveKey& reservekey, int64& nFeeRet);
+		bool SelectStakeCoins(int64 nReserveBalance, unsigned int nSpendTime, std::vector<std::pair<const CWalletTx*,unsigned int> >& vCoinsRet, int64& nValueRet);
 		bool AddCoinstakeInputs(Core::CTransaction& txNew);
 		bool CommitTransaction(CWalletTx& wtxNew, CReserveKey& reservekey);
 		std::string SendMoney(CScript scriptPubKey, int64 nValue, CWalletTx& wtxNew, bool fAskFee=false);
@@ -757,6 +819,7 @@ namespace Wallet
 	};
 
 	bool GetWalletFile(CWallet* pwallet, std::string &strWalletFileOut);
+	void BenchBalance(unsigned int nTransactions);
 
 }
 